@@ -0,0 +1,155 @@
+#ifndef _BENCH_UTIL_H_
+#define _BENCH_UTIL_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Helpers shared by the benchmarks: the clock, a null stream, the report line and the synthetic header
+/// generator. Everything is inline, so a benchmark links only the sources it measures
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <stdio.h>      // sprintf
+#include <stdlib.h>     // srand, rand
+#include <time.h>       // clock_gettime
+#include <iostream>     // std::cout
+#include <iomanip>      // std::setw, std::setprecision
+#include <streambuf>    // std::streambuf
+#include <string>
+
+/// discards everything written to it
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) { return c; }
+    std::streamsize xsputn(const char *, std::streamsize n) { return n; }
+};
+
+/// @return the monotonic time in seconds
+static inline double Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// print the name and the value of a measure, @return cout to append more columns and endl
+static inline std::ostream &Report(const std::string &name, double value, const std::string &unit) {
+    return std::cout << "    " << std::setw(36) << std::left << name << std::fixed << std::setprecision(2)
+                     << std::setw(10) << std::right << value << " " << unit;
+}
+
+/// @brief A generated header
+typedef struct {
+    std::string source;
+    size_t      types;      ///< number of struct/union/enum definitions, nested ones included
+} Corpus;
+
+/// append a struct or union with @var depth more levels of named types nested inside
+/// the members are 4 or 8 bytes, or char arrays sized by a macro
+static inline void AddNestedType(std::string &src, size_t &types, int id, int depth, const std::string &indent) {
+    const char *kinds[] = { "struct", "union" };
+    const char *members[] = { "int", "long", "unsigned int", "float", "double", "unsigned long" };
+    char line[256];
+
+    const char *kind = (0 == depth % 3) ? kinds[rand() % 2] : kinds[0];
+    sprintf(line, "%s%s Nested_%d_%d\n%s{\n", indent.c_str(), kind, id, depth, indent.c_str());
+    src += line;
+    ++types;
+
+    int count = rand() % 6 + 2;
+    for (int i = 0; i < count; ++i) {
+        if (0 == i % 4) {
+            sprintf(line, "%s    char label_%d[BENCH_LENGTH_%d];\n", indent.c_str(), i, rand() % 8);
+        } else {
+            sprintf(line, "%s    %s field_%d;\n", indent.c_str(), members[rand() % 6], i);
+        }
+        src += line;
+    }
+
+    if (depth > 0) AddNestedType(src, types, id, depth - 1, indent + "    ");
+
+    sprintf(line, "%s} level_%d;\n", indent.c_str(), depth);
+    src += line;
+}
+
+/// make a header of about @var size bytes: structs and unions nested a few levels deep, big enums, numeric
+/// macros used as array sizes, multi-line function-like macros and long comment blocks.
+/// Different seeds make headers that can be parsed together; no value is 0, which the parser doesn't take
+/// as a number
+static inline Corpus MakeHeader(size_t size, unsigned int seed) {
+    Corpus corpus = { "", 0 };
+    std::string &src = corpus.source;
+    char line[512];
+
+    srand(seed);
+    src.reserve(size + 4096);
+
+    // the array sizes, every file defines them as it can be parsed alone
+    src += "#ifndef BENCH_LENGTHS\n#define BENCH_LENGTHS\n";
+    for (int i = 0; i < 8; ++i) {
+        sprintf(line, "#define BENCH_LENGTH_%d %d\n", i, (i + 1) * 4);
+        src += line;
+    }
+    src += "#endif\n\n";
+
+    for (int n = 0; src.length() < size; ++n) {
+        int id = seed * 1000000 + n;
+
+        if (0 == n % 20) {
+            src += "/*\n";
+            for (int i = 0; i < 12; ++i) {
+                src += " * A long comment block describing the structures below: what each field means, the units\n"
+                       " * of the values, the byte order of the binary records and which version added them.\n";
+            }
+            src += " */\n";
+
+            sprintf(line, "#define BENCH_CHECK_%d(value, limit) \\\n"
+                          "    do { \\\n"
+                          "        if ((value) > (limit)) { \\\n"
+                          "            report_error(\"value out of range\", __FILE__, __LINE__); \\\n"
+                          "        } \\\n"
+                          "    } while (0)\n\n", id);
+            src += line;
+        }
+
+        if (0 == n % 50) {
+            // a big enum
+            sprintf(line, "typedef enum BenchEnum_%d\n{\n", id);
+            src += line;
+            for (int i = 0; i < 200; ++i) {
+                if (0 == i % 10) {
+                    sprintf(line, "    kBenchValue_%d_%d = %d,\n", id, i, i * 3 + 1);
+                } else {
+                    sprintf(line, "    kBenchValue_%d_%d,\n", id, i);
+                }
+                src += line;
+            }
+            sprintf(line, "    kBenchLast_%d\n} BenchEnum_%d;\n\n", id, id);
+            src += line;
+            ++corpus.types;
+        }
+
+        sprintf(line, "#define BENCH_LIMIT_%d %d\n\n// generated structure %d\ntypedef struct BenchStruct_%d\n{\n",
+                id, rand() % 1000 + 1, n, id);
+        src += line;
+        ++corpus.types;
+
+        for (int i = 0; i < 12; ++i) {
+            if (0 == i % 5) {
+                sprintf(line, "    char name_%d[BENCH_LENGTH_%d];   /* sized by a macro */\n", i, rand() % 8);
+            } else {
+                sprintf(line, "    %s member_%d;   // trailing comment\n", (0 == i % 2) ? "int" : "double", i);
+            }
+            src += line;
+        }
+
+        // nested types, 0 to 4 levels deep
+        if (0 != n % 4) AddNestedType(src, corpus.types, id, n % 5, "    ");
+
+        sprintf(line, "} BenchStruct_%d;\n\n", id);
+        src += line;
+    }
+
+    return corpus;
+}
+
+#endif  // _BENCH_UTIL_H_
@@ -0,0 +1,182 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Benchmark of the binary data decoding throughput
+///
+/// The types of test/Employee.h are parsed, then binary dumps of 1 up to millions of records of a type are
+/// generated, with random bytes except for the enum members which get valid values. Each dump is decoded
+/// by a single DataReader::PrintTypeData call, record by record, the text is counted and thrown away.
+/// It reports records/s, input bytes/s, output bytes/s and the peak memory of each run
+///
+/// The peak is VmHWM of /proc/self/status, which is reset before each run by writing 5 to
+/// /proc/self/clear_refs; when that's not supported the peak of the whole process is reported instead
+///
+/// Build and run (from the top folder):
+///     g++ -O2 -DSTATS_HOT_COUNTERS -iquote include bench/decoder_bench.cpp $(ls src/*.cpp | grep -v main.cpp) -lpthread -o decoder_bench
+///     ./decoder_bench [max number of records] [type name] [--perf]
+///
+/// With --perf, the phases of each run are printed with their hardware events, @see Stats::EnableEvents
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <stdlib.h>     // atoi, rand
+#include <string.h>     // memcpy, strcmp
+#include <sys/resource.h>   // getrusage
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <set>
+
+#include "utility.h"
+#include "Stats.h"
+#include "TypeParser.h"
+#include "TypeDatabase.h"
+#include "DataReader.h"
+#include "bench_util.h"
+
+using namespace std;
+
+/// Logging level
+LogLevels g_log_level = kError;
+
+/// counts what is written to it and discards it
+class CountingBuffer : public streambuf {
+public:
+    CountingBuffer() : count_(0) {}
+    unsigned long long count() const { return count_; }
+
+protected:
+    int overflow(int c) { ++count_; return c; }
+    streamsize xsputn(const char *, streamsize n) { count_ += n; return n; }
+
+private:
+    unsigned long long count_;
+};
+
+/// reset the peak resident memory, @return false if it's not supported
+static bool ResetPeakMemory() {
+    ofstream os("/proc/self/clear_refs");
+    os << "5";
+    os.close();
+
+    return !os.fail();
+}
+
+/// @return the peak resident memory in KB since the last reset
+static long PeakMemory() {
+    ifstream is("/proc/self/status");
+    string line;
+    while (getline(is, line)) {
+        if (0 == line.compare(0, 6, "VmHWM:")) return atol(line.c_str() + 6);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/// fill a record of a type with random bytes, and valid values for the enum members
+static void FillRecord(const TypeDatabase &types, const TypeDatabase::TypeRecord &type, bool is_union, char *data) {
+    for (uint32_t i = 0; i < type.size; ++i) {
+        data[i] = static_cast<char>(rand() % 95 + 32);  // printable
+    }
+
+    if (is_union || 0 == (type.flags & TypeDatabase::kStructDefined)) return;
+
+    for (uint32_t i = type.struct_first; i < type.struct_first + type.struct_count; ++i) {
+        const TypeDatabase::MemberRecord &member = types.member(i);
+        char *member_data = data + member.offset;
+        if (TypeDatabase::kNoType != member.type && 0 == member.array_size
+            && 0 == (member.flags & TypeDatabase::kBitfieldMember)) {
+            const TypeDatabase::TypeRecord &member_type = types.type(member.type);
+
+            if (kStructName == member_type.kind) {
+                FillRecord(types, member_type, false, member_data);
+            } else if (kEnumName == member_type.kind && member_type.enum_count > 0) {
+                int value = types.enumerator(member_type.enum_first + rand() % member_type.enum_count).value;
+                memcpy(member_data, &value, sizeof(value));
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    bool perf = (argc > 1 && 0 == strcmp(argv[argc - 1], "--perf"));
+    if (perf) {
+        --argc;
+        if (!Stats::EnableEvents()) cout << "Hardware events are not available, only the times are reported" << endl;
+    }
+
+    size_t max_records = (argc > 1 && atoi(argv[1]) > 0) ? atoi(argv[1]) : 1000000;
+    string type_name = (argc > 2) ? argv[2] : "Employee";
+
+    // the type definitions, the log lines printed while parsing are thrown away
+    CountingBuffer output;
+    streambuf *console = cout.rdbuf(&output);
+
+    set<string> paths;
+    paths.insert("test");
+
+    TypeParser parser;
+    parser.SetIncludePaths(paths);
+    parser.ParseFiles();
+
+    string image;
+    TypeDatabase::Build(parser, image);
+    TypeDatabase types;
+    types.Open(image.data(), image.length());
+
+    cout.rdbuf(console);
+
+    const TypeDatabase::TypeRecord *type = types.is_open() ? types.FindType(type_name) : NULL;
+    if (NULL == type || 0 == type->size) {
+        cerr << "Unknown type: " << type_name << " (run it from the top folder)" << endl;
+        return 1;
+    }
+
+    srand(2013);
+    bool peak_reset = ResetPeakMemory();
+    cout << "Type: " << type_name << ", " << type->size << " bytes per record, peak memory "
+         << (peak_reset ? "of each run" : "of the process") << endl;
+
+    for (size_t records = 1; records <= max_records; records *= 10) {
+        size_t size = records * type->size;
+
+        // the reader takes the buffer over
+        char *buffer = new char[size];
+        FillRecord(types, *type, false, buffer);
+        for (size_t i = 1; i < records; ++i) {
+            memcpy(buffer + i * type->size, buffer, type->size);
+        }
+
+        ResetPeakMemory();
+        Stats::Reset();
+        output.pubsync();
+        unsigned long long written = output.count();
+
+        double start = Now();
+        {
+            DataReader reader(types, buffer, size);
+
+            cout.rdbuf(&output);
+            reader.PrintTypeData(type_name, false, records);
+            cout.rdbuf(console);
+        }
+        double seconds = Now() - start;
+        written = output.count() - written;
+
+        ostringstream name;
+        name << records << " records";
+        Report(name.str(), seconds * 1000, "ms")
+             << setw(12) << setprecision(0) << records / seconds << " records/s"
+             << setw(9) << setprecision(2) << size / seconds / (1024 * 1024) << " MB/s in"
+             << setw(9) << written / seconds / (1024 * 1024) << " MB/s out"
+             << setw(9) << PeakMemory() / 1024.0 << " MB peak" << endl;
+        if (perf) Stats::Print(cout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Benchmark of the logging cost while parsing
+///
+/// A synthetic header is parsed with the messages filtered out by g_log_level, and with all of them written
+/// to a null stream. The filtered calls are also timed alone, with the message made eagerly (Debug) and lazily
+/// (LOG_DEBUG). Build it twice to see what the compile-time level removes:
+///
+/// Build and run (from the top folder):
+///     g++ -O2 -iquote include bench/log_bench.cpp $(ls src/*.cpp | grep -v main.cpp) -lpthread -o log_bench
+///     g++ -O2 -DLOG_MAX_LEVEL=kError -iquote include bench/log_bench.cpp $(ls src/*.cpp | grep -v main.cpp) -lpthread -o log_bench_quiet
+///     ./log_bench [size in MB]
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <stdlib.h>     // atoi
+#include <iostream>
+#include <string>
+
+#include "utility.h"
+#include "TypeParser.h"
+#include "bench_util.h"
+
+using namespace std;
+
+/// Logging level
+LogLevels g_log_level = kError;
+
+static double ParseTime(const string &src, int rounds) {
+    double best = 1e9;
+
+    for (int i = 0; i < rounds; ++i) {
+        TypeParser parser;
+
+        double start = Now();
+        parser.ParseSource(src);
+        best = min(best, Now() - start);
+    }
+
+    return best;
+}
+
+int main(int argc, char **argv) {
+    size_t size = static_cast<size_t>((argc > 1 && atoi(argv[1]) > 0) ? atoi(argv[1]) : 8) * 1024 * 1024;
+    const int kRounds = 5;
+    const int kCalls = 1000000;
+
+    Corpus corpus = MakeHeader(size, 1);
+    const string &src = corpus.source;
+    cout << "Header size: " << src.length() << " bytes, " << corpus.types << " types, compiled-in level: "
+         << (kInfo == LOG_MAX_LEVEL ? "info" : (kDebug == LOG_MAX_LEVEL ? "debug" : "error")) << endl;
+
+    NullBuffer null_buffer;
+    streambuf *console = cout.rdbuf();
+
+    // the messages are filtered out at run time
+    g_log_level = kError;
+    Report("parse, messages filtered", ParseTime(src, kRounds) * 1000, "ms") << endl;
+
+    // the messages are made and written to nowhere
+    g_log_level = kInfo;
+    cout.rdbuf(&null_buffer);
+    double all = ParseTime(src, kRounds);
+    cout.rdbuf(console);
+    Report("parse, messages written", all * 1000, "ms") << endl;
+
+    // a filtered call alone
+    g_log_level = kError;
+    string name = "BenchStruct_1001234";
+
+    double start = Now();
+    for (int i = 0; i < kCalls; ++i) {
+        Debug("Add member: " + name);
+    }
+    Report("filtered Debug(\"...\" + name)", (Now() - start) * 1e9 / kCalls, "ns/call") << endl;
+
+    start = Now();
+    for (int i = 0; i < kCalls; ++i) {
+        LOG_DEBUG("Add member: " << name);
+    }
+    Report("filtered LOG_DEBUG(\"...\" << name)", (Now() - start) * 1e9 / kCalls, "ns/call") << endl;
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Benchmark of the parser throughput
+///
+/// Synthetic headers of several sizes are generated: thousands of structs and unions nested a few levels deep,
+/// big enums, numeric macros used as array sizes, multi-line function-like macros with line continuations,
+/// and long comment blocks. Each corpus is parsed from memory with ParseSource, and from a temporary folder
+/// with ParseFiles, which finds, reads, tokenizes and parses the files like the program does.
+///
+/// With -j, only finding, reading and tokenizing the files run on the worker pool, the parsing is serial,
+/// @see TypeParser::SetJobs; so the jobs can't be faster than the tokenizing phase of a single job.
+///
+/// Build and run (from the top folder):
+///     g++ -O2 -DSTATS_HOT_COUNTERS -iquote include bench/parser_bench.cpp $(ls src/*.cpp | grep -v main.cpp) -lpthread -o parser_bench
+///     ./parser_bench [largest size in MB] [number of files] [--perf]
+///
+/// With --perf, the phases of the last ParseFiles run of each corpus are printed with their hardware events,
+/// @see Stats::EnableEvents
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <stdio.h>      // sprintf
+#include <stdlib.h>     // atoi, rand, mkdtemp
+#include <string.h>     // strcmp
+#include <unistd.h>     // unlink, rmdir
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <set>
+
+#include "utility.h"
+#include "Stats.h"
+#include "TypeParser.h"
+#include "bench_util.h"
+
+using namespace std;
+
+/// Logging level
+LogLevels g_log_level = kError;
+
+static void Report(const string &name, size_t bytes, size_t types, double seconds) {
+    Report(name, seconds * 1000, "ms")
+         << setw(10) << bytes / seconds / (1024 * 1024) << " MB/s"
+         << setw(12) << setprecision(0) << types / seconds << " types/s" << endl;
+}
+
+static double ParseSourceTime(const string &src, int rounds) {
+    double best = 1e9;
+
+    for (int i = 0; i < rounds; ++i) {
+        TypeParser parser;
+
+        double start = Now();
+        parser.ParseSource(src);
+        best = min(best, Now() - start);
+    }
+
+    return best;
+}
+
+static double ParseFilesTime(const string &folder, size_t jobs, int rounds) {
+    set<string> paths;
+    paths.insert(folder);
+    double best = 1e9;
+
+    NullBuffer null_buffer;
+    streambuf *console = cout.rdbuf(&null_buffer);
+
+    for (int i = 0; i < rounds; ++i) {
+        TypeParser parser;
+        parser.SetIncludePaths(paths);
+        parser.SetJobs(jobs);
+
+        Stats::Reset();
+
+        double start = Now();
+        parser.ParseFiles();
+        best = min(best, Now() - start);
+    }
+
+    cout.rdbuf(console);
+    return best;
+}
+
+int main(int argc, char **argv) {
+    bool perf = (argc > 1 && 0 == strcmp(argv[argc - 1], "--perf"));
+    if (perf) {
+        --argc;
+        if (!Stats::EnableEvents()) cout << "Hardware events are not available, only the times are reported" << endl;
+    }
+
+    int largest = (argc > 1 && atoi(argv[1]) > 0) ? atoi(argv[1]) : 16;
+    int file_count = (argc > 2 && atoi(argv[2]) > 0) ? atoi(argv[2]) : 4;
+    const int kRounds = 3;
+
+    char folder[] = "/tmp/parser_bench_XXXXXX";
+    if (NULL == mkdtemp(folder)) {
+        cerr << "Failed to create a temporary folder" << endl;
+        return 1;
+    }
+
+    for (int mb = 1; mb <= largest; mb *= 4) {
+        size_t size = static_cast<size_t>(mb) * 1024 * 1024;
+
+        // the whole corpus, and the same amount split into files
+        Corpus whole = MakeHeader(size, 1);
+
+        vector<string> files;
+        size_t bytes = 0, types = 0;
+        for (int i = 0; i < file_count; ++i) {
+            Corpus part = MakeHeader(size / file_count, i + 1);
+            bytes += part.source.length();
+            types += part.types;
+
+            char name[64];
+            sprintf(name, "/bench_%d.h", i);
+            files.push_back(folder + string(name));
+            ofstream file(files.back().c_str(), ios::out | ios::binary);
+            file << part.source;
+        }
+
+        cout << "Corpus: " << whole.source.length() / 1024 << " KB, " << whole.types << " types; "
+             << file_count << " files of " << bytes / 1024 / file_count << " KB" << endl;
+
+        Report("ParseSource", whole.source.length(), whole.types, ParseSourceTime(whole.source, kRounds));
+        Report("ParseFiles, 1 job", bytes, types, ParseFilesTime(folder, 1, kRounds));
+        Report("ParseFiles, 4 jobs", bytes, types, ParseFilesTime(folder, 4, kRounds));
+        if (perf) Stats::Print(cout);
+
+        for (size_t i = 0; i < files.size(); ++i) {
+            unlink(files[i].c_str());
+        }
+    }
+
+    rmdir(folder);
+    return 0;
+}
@@ -0,0 +1,251 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Scaling check of the parser with pathological inputs
+///
+/// Each case makes an input of n units (members, enumerators, lines...) that stresses one path: a single
+/// line of about 10 MB, an enum of 100k members, a huge comment block, unions nested deeply, thousands of
+/// macros, and lines joined by continuations. Every case is parsed at n, 2n, 4n and 8n, and the time of
+/// each phase (@see Stats) is fitted against n: the slope of log(time / (n log n)) over log n is about 0
+/// when a phase grows as n log n, and about 1 when it's quadratic.
+///
+/// The program fails when a phase of a case grows faster than n log n, i.e. when the slope is over
+/// kMaxExcessSlope. Phases taking less than kMinSeconds at 8n are too noisy to fit and are not checked
+///
+/// Build and run (from the top folder):
+///     g++ -O2 -iquote include bench/scaling_bench.cpp $(ls src/*.cpp | grep -v main.cpp) -lpthread -o scaling_bench
+///     ./scaling_bench [scale of n, 1 by default]
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <stdio.h>      // snprintf
+#include <stdlib.h>     // atof
+#include <math.h>       // log
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "utility.h"
+#include "Stats.h"
+#include "TypeParser.h"
+#include "bench_util.h"
+
+using namespace std;
+
+/// Logging level
+LogLevels g_log_level = kError;
+
+/// the slope over which a phase is taken as growing faster than n log n
+static const double kMaxExcessSlope = 0.25;
+
+/// the time under which a phase is not checked
+static const double kMinSeconds = 0.005;
+
+/// n is doubled this number of times
+static const int kSizes = 4;
+
+typedef string (*MakeInput)(size_t n);
+
+/// @brief A pathological input
+typedef struct {
+    const char  *name;
+    MakeInput   make;
+    size_t      n;          ///< smallest n at scale 1
+} Case;
+
+/// a macro of n tokens on a single line, then a line comment as long
+/// a declaration cannot be made on a single line, as the parser reads the members of a struct line by line
+static string MakeLongLine(size_t n) {
+    string src = "#define LONG_LINE";
+    char token[64];
+
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(token, sizeof(token), " token_with_a_long_name_%lu +", static_cast<unsigned long>(i));
+        src += token;
+    }
+
+    src += " 1\n//";
+    for (size_t i = 0; i < n; ++i) {
+        src += " a long line comment with words";
+    }
+
+    return src + "\nstruct AfterLongLine\n{\n    int value;\n};\n";
+}
+
+/// an enum of n members
+static string MakeHugeEnum(size_t n) {
+    string src = "enum HugeEnum\n{\n";
+    char member[64];
+
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(member, sizeof(member), (0 == i % 100) ? "    kHuge_%lu = %lu,\n" : "    kHuge_%lu,\n",
+                static_cast<unsigned long>(i), static_cast<unsigned long>(i + 1));
+        src += member;
+    }
+
+    return src + "    kHugeLast\n};\n";
+}
+
+/// a comment block of n lines before a struct
+static string MakeHugeComment(size_t n) {
+    string src = "/*\n";
+
+    for (size_t i = 0; i < n; ++i) {
+        src += " * a line of a huge comment block, with // and /* but no end mark * / ** /\n";
+    }
+
+    return src + " */\nstruct AfterComment\n{\n    int value;\n};\n";
+}
+
+/// unions and structs nested n levels deep
+static string MakeDeepNesting(size_t n) {
+    string src = "typedef union Deep\n{\n";
+    char line[128];     // with two 20-digit numbers at most
+
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(line, sizeof(line), "%s Level_%lu {\n    int value_%lu;\n", (0 == i % 2) ? "struct" : "union",
+                static_cast<unsigned long>(i), static_cast<unsigned long>(i));
+        src += line;
+    }
+
+    for (size_t i = n; i > 0; --i) {
+        snprintf(line, sizeof(line), "} level_%lu;\n", static_cast<unsigned long>(i - 1));
+        src += line;
+    }
+
+    return src + "} Deep;\n";
+}
+
+/// n numeric macros, each used as an array size
+static string MakeManyMacros(size_t n) {
+    string src;
+    char line[256];     // with four 20-digit numbers at most
+
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(line, sizeof(line), "#define MACRO_LENGTH_%lu %lu\nstruct Sized_%lu\n{\n    char name[MACRO_LENGTH_%lu];\n};\n",
+                static_cast<unsigned long>(i), static_cast<unsigned long>((i % 16 + 1) * 4),
+                static_cast<unsigned long>(i), static_cast<unsigned long>(i));
+        src += line;
+    }
+
+    return src;
+}
+
+/// a macro of n lines joined by continuations
+static string MakeLongContinuation(size_t n) {
+    string src = "#define LONG_MACRO(x) \\\n";
+
+    for (size_t i = 0; i < n; ++i) {
+        src += "    do { if ((x) > 0) { report(\"continued line\", __LINE__); } } while (0); \\\n";
+    }
+
+    return src + "    (x)\nstruct AfterMacro\n{\n    int value;\n};\n";
+}
+
+/// parse an input, @return the time of each phase
+static vector<double> ParseTime(const string &src) {
+    NullBuffer null_buffer;
+    streambuf *console = cout.rdbuf(&null_buffer);
+
+    Stats::Reset();
+    {
+        TypeParser parser;
+        parser.ParseSource(src);
+    }
+
+    cout.rdbuf(console);
+
+    vector<double> seconds;
+    for (int i = 0; i < Stats::kPhaseCount; ++i) {
+        seconds.push_back(Stats::seconds(static_cast<Stats::Phase>(i)));
+    }
+
+    return seconds;
+}
+
+/// least squares slope of y over x
+static double Slope(const vector<double> &x, const vector<double> &y) {
+    double mean_x = 0, mean_y = 0;
+    for (size_t i = 0; i < x.size(); ++i) {
+        mean_x += x[i] / x.size();
+        mean_y += y[i] / y.size();
+    }
+
+    double covariance = 0, variance = 0;
+    for (size_t i = 0; i < x.size(); ++i) {
+        covariance += (x[i] - mean_x) * (y[i] - mean_y);
+        variance += (x[i] - mean_x) * (x[i] - mean_x);
+    }
+
+    return covariance / variance;
+}
+
+int main(int argc, char **argv) {
+    double scale = (argc > 1 && atof(argv[1]) > 0) ? atof(argv[1]) : 1;
+    const char *kPhaseNames[] = { "discovery", "tokenizing", "cache", "preprocessing", "parsing", "layout",
+                                  "decoding" };
+
+    // the long line is about 10 MB at 8n
+    const Case cases[] = {
+        { "single long line",   MakeLongLine,           20000 },
+        { "100k-member enum",   MakeHugeEnum,           12500 },
+        { "huge comment block", MakeHugeComment,        20000 },
+        { "deeply nested types", MakeDeepNesting,      1000 },
+        { "many macros",        MakeManyMacros,         5000 },
+        { "long continuation",  MakeLongContinuation,   20000 },
+    };
+
+    int failures = 0;
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        vector<double> log_n;
+        vector< vector<double> > times;   // index - size, phase
+
+        cout << cases[c].name << ":" << endl;
+
+        for (int i = 0; i < kSizes; ++i) {
+            size_t n = static_cast<size_t>(cases[c].n * scale) << i;
+            string src = cases[c].make(n);
+
+            // the best of a few rounds
+            vector<double> best = ParseTime(src);
+            for (int round = 1; round < 3; ++round) {
+                vector<double> seconds = ParseTime(src);
+                for (size_t p = 0; p < best.size(); ++p) best[p] = min(best[p], seconds[p]);
+            }
+
+            log_n.push_back(log(static_cast<double>(n)));
+            times.push_back(best);
+
+            cout << "    n = " << setw(8) << left << n << setw(10) << right << src.length() / 1024 << " KB";
+            for (int p = 0; p < Stats::kPhaseCount; ++p) {
+                if (best[p] > 0) {
+                    cout << "  " << kPhaseNames[p] << " " << fixed << setprecision(2) << best[p] * 1000 << " ms";
+                }
+            }
+            cout << endl;
+        }
+
+        for (int p = 0; p < Stats::kPhaseCount; ++p) {
+            if (times.back()[p] < kMinSeconds) continue;
+
+            // time / (n log n)
+            vector<double> y;
+            for (int i = 0; i < kSizes; ++i) {
+                y.push_back(log(max(times[i][p], 1e-9)) - log_n[i] - log(log_n[i]));
+            }
+
+            double slope = Slope(log_n, y);
+            bool failed = slope > kMaxExcessSlope;
+            if (failed) ++failures;
+
+            cout << "    " << kPhaseNames[p] << ": grows as n log n * n^" << fixed << setprecision(2) << slope
+                 << (failed ? "  FAILED" : "  ok") << endl;
+        }
+    }
+
+    cout << (0 == failures ? "All phases scale as n log n or better" : "Some phases grow faster than n log n")
+         << endl;
+    return (0 == failures) ? 0 : 1;
+}
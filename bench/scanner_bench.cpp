@@ -0,0 +1,114 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Micro benchmark of the character class scanning kernels
+///
+/// A large synthetic header is generated in memory (@see MakeHeader), then it is scanned token by token
+/// (FindDelimiter) and comment by comment (FindEither) with every kernel supported by the CPU, and tokenized
+/// by the lexer
+///
+/// Build and run (from the top folder):
+///     g++ -O2 -iquote include bench/scanner_bench.cpp src/CharScanner.cpp src/Lexer.cpp -o scanner_bench
+///     ./scanner_bench [size in MB]
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <stdlib.h>     // atoi
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include "utility.h"
+#include "CharScanner.h"
+#include "Lexer.h"
+#include "bench_util.h"
+
+using namespace std;
+
+/// Logging level
+LogLevels g_log_level = kError;
+
+/// walk the source like the lexer does for tokens: find a delimiter, step over it
+static size_t ScanTokens(CharScanner::Kernel kernel, const string &src) {
+    const char *p = src.data();
+    const char *end = p + src.length();
+    size_t count = 0;
+
+    while (p < end) {
+        p = CharScanner::FindDelimiter(kernel, p, end);
+        if (p < end) ++p;
+        ++count;
+    }
+
+    return count;
+}
+
+/// walk the source like the lexer does for comment blocks
+static size_t ScanComments(CharScanner::Kernel kernel, const string &src) {
+    const char *p = src.data();
+    const char *end = p + src.length();
+    size_t count = 0;
+
+    while ((p = CharScanner::FindEither(kernel, p, end, '*', '\n')) < end) {
+        ++p;
+        ++count;
+    }
+
+    return count;
+}
+
+static void Report(const string &name, double seconds, size_t bytes, size_t count) {
+    Report(name, seconds * 1000, "ms") << setw(10) << bytes / seconds / (1024 * 1024) << " MB/s"
+                                       << setw(12) << count << endl;
+}
+
+int main(int argc, char **argv) {
+    size_t size = (argc > 1 ? atoi(argv[1]) : 64) * 1024 * 1024;
+    const int kRounds = 5;
+
+    string src = MakeHeader(size, 1).source;
+    cout << "Header size: " << src.length() << " bytes, selected kernel: "
+         << CharScanner::KernelName(CharScanner::Selected()) << endl;
+
+    const CharScanner::Kernel kernels[] = { CharScanner::kScalar, CharScanner::kSse2, CharScanner::kAvx2 };
+    for (size_t k = 0; k < sizeof(kernels)/sizeof(kernels[0]); ++k) {
+        if (!CharScanner::IsSupported(kernels[k])) continue;
+
+        cout << CharScanner::KernelName(kernels[k]) << ":" << endl;
+
+        double best = 1e9;
+        size_t count = 0;
+        for (int i = 0; i < kRounds; ++i) {
+            double start = Now();
+            count = ScanTokens(kernels[k], src);
+            best = min(best, Now() - start);
+        }
+        Report("FindDelimiter", best, src.length(), count);
+
+        best = 1e9;
+        for (int i = 0; i < kRounds; ++i) {
+            double start = Now();
+            count = ScanComments(kernels[k], src);
+            best = min(best, Now() - start);
+        }
+        Report("FindEither", best, src.length(), count);
+    }
+
+    // whole lexer with the selected kernel
+    double best = 1e9;
+    size_t count = 0;
+    for (int i = 0; i < kRounds; ++i) {
+        TokenList tokens;
+        tokens.reserve(src.length() / 4);
+
+        double start = Now();
+        Lexer lexer(src.data(), src.length());
+        count = lexer.Tokenize(tokens);
+        best = min(best, Now() - start);
+    }
+
+    cout << "lexer:" << endl;
+    Report("Tokenize", best, src.length(), count);
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#ifndef _ABI_H_
+#define _ABI_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Description of a target ABI: the sizes and alignments of the basic data types and pointers, and how
+/// structs and unions are padded
+///
+/// The layout rules are the natural alignment ones of the common C compilers: a member starts at a multiple of
+/// its alignment, a struct or union is aligned to its most aligned member but at least to struct_align, and its
+/// size is rounded up to its alignment (the tail padding), so the members of an array of it stay aligned.
+///
+/// Bitfields are allocated by the System V rules, or by the Microsoft ones with ms_bitfields, as MSVC and
+/// gcc -mms-bitfields do, @see TypeParser::LayoutMembers
+///
+/// An ABI is either a preset (@see kPresets) or a preset with some values overridden, e.g.
+///     lp64                                x86-64 and AArch64 Linux/macOS
+///     ilp32,long_long=8:8,double=8:8      32-bit ARM EABI, where the 8-byte types are aligned to 8
+///     ilp32,struct_align=4                old ARM APCS, where every struct is aligned to 4 at least
+///     lp64,ms_bitfields=1                 x86-64 Linux built with gcc -mms-bitfields
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <string>
+
+using namespace std;
+
+class Abi
+{
+public:
+    /// basic data types whose size and alignment depend on the ABI
+    enum Scalar {
+        kChar,
+        kBool,
+        kShort,
+        kInt,
+        kLong,
+        kLongLong,          ///< also __int64 and int64_t
+        kFloat,
+        kDouble,
+        kLongDouble,
+        kPointer,
+        kSize,              ///< size_t, ssize_t, ptrdiff_t...
+        kWchar,
+        kEnum,
+        kScalarCount
+    };
+
+    /// @brief Size and alignment of a type in bytes
+    typedef struct {
+        size_t  size;
+        size_t  align;
+    } Layout;
+
+    /// the default ABI, ilp32
+    Abi(void);
+
+    /// set the ABI by a preset name, optionally followed by overrides separated by commas:
+    ///     <scalar>=<size>[:<align>]   e.g. long_double=16:16, the alignment is the size by default
+    ///     struct_align=<align>        minimum alignment of structs and unions
+    ///     ms_bitfields=<0|1>          whether the bitfields are allocated by the Microsoft rules
+    /// the scalar names are the ones of @var kScalarNames
+    /// @return false if the spec is not valid, the ABI is not changed then
+    bool Parse(const string &spec);
+
+    /// the preset name, or the spec given to @method Parse
+    const string &name() const { return name_; }
+
+    const Layout &scalar(Scalar scalar) const { return scalars_[scalar]; }
+    size_t struct_align() const { return struct_align_; }
+    bool ms_bitfields() const { return ms_bitfields_; }
+
+    /// the biggest alignment of the scalars, which __attribute__((aligned)) without a value stands for
+    size_t biggest_align() const;
+
+    /// the basic type names and which scalar each one is, e.g. "uint32_t" is kInt
+    /// the qualifiers are not part of the names: "unsigned long" is parsed as "long"
+    static size_t type_name_count();
+    static const char *type_name(size_t index);
+    static Scalar type_scalar(size_t index);
+
+    /// names of the scalars in a spec, indexed by @enum Scalar
+    static const char *const kScalarNames[kScalarCount];
+
+private:
+    /// @brief A named ABI
+    typedef struct {
+        const char  *name;
+        Layout      scalars[kScalarCount];
+        size_t      struct_align;
+        bool        ms_bitfields;
+    } Preset;
+
+    static const Preset kPresets[];
+
+    void SetPreset(const Preset &preset);
+
+    string  name_;
+    Layout  scalars_[kScalarCount];
+    size_t  struct_align_;
+    bool    ms_bitfields_;
+};
+
+#endif  // _ABI_H_
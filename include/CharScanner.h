@@ -0,0 +1,72 @@
+#ifndef _CHAR_SCANNER_H_
+#define _CHAR_SCANNER_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Character class scanning for the lexer
+///
+/// The lexer spends most of its time looking for the end of a token (the next delimiter, blank or line break)
+/// and for the end of a comment block. The kernels here check 16 (SSE2) or 32 (AVX2) bytes at a time,
+/// the best one supported by the CPU is selected at runtime, with a plain table lookup as the fallback
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <stddef.h>     // size_t
+
+class CharScanner
+{
+public:
+    /// @enum implementations of the scanning kernels
+    enum Kernel {
+        kScalar,
+        kSse2,
+        kAvx2,
+    };
+
+    /// whether the character is a token delimiter (@see Lexer::kTokenDelimiters) or a blank
+    static bool IsDelimiter(char ch) { return Table().delimiters[static_cast<unsigned char>(ch)]; }
+
+    /// find the first delimiter or blank from @var p
+    /// @return position of the delimiter, or @var end if not found
+    static const char *FindDelimiter(const char *p, const char *end) { return Table().find_delimiter(p, end); }
+
+    /// find the first occurrence of either @var a or @var b from @var p
+    /// @return position of the character, or @var end if not found
+    static const char *FindEither(const char *p, const char *end, char a, char b) {
+        return Table().find_either(p, end, a, b);
+    }
+
+    /// same as above but with a specified kernel, mainly for benchmarking and verification
+    static const char *FindDelimiter(Kernel kernel, const char *p, const char *end);
+    static const char *FindEither(Kernel kernel, const char *p, const char *end, char a, char b);
+
+    /// the kernel selected for current CPU
+    static Kernel Selected() { return Table().kernel; }
+
+    /// whether the kernel is built in and supported by current CPU
+    static bool IsSupported(Kernel kernel);
+
+    static const char *KernelName(Kernel kernel);
+
+private:
+    typedef const char *(*FindDelimiterFunc)(const char *p, const char *end);
+    typedef const char *(*FindEitherFunc)(const char *p, const char *end, char a, char b);
+
+    typedef struct {
+        bool                delimiters[256];    ///< lookup table for the scalar kernel
+        Kernel              kernel;
+        FindDelimiterFunc   find_delimiter;
+        FindEitherFunc      find_either;
+    } Dispatch;
+
+    /// the lookup table and selected kernels, initialized once on first use
+    static const Dispatch &Table();
+    static Dispatch Initialize();
+    static bool Verify(Kernel kernel, const bool *delimiters);
+
+    static FindDelimiterFunc DelimiterKernel(Kernel kernel);
+    static FindEitherFunc EitherKernel(Kernel kernel);
+};
+
+#endif  // _CHAR_SCANNER_H_
@@ -2,7 +2,12 @@
 #define _TYPE_DATA_READER_
 
 #include "TypeParser.h"
+#include "TypeDatabase.h"
 #include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <set>
 
 using namespace std;
 
@@ -10,10 +15,12 @@ using namespace std;
 ///
 /// Binary memory data reader for C types
 ///
-/// Based on the type definitions from TypeParser, 
+/// Based on the type definitions from TypeParser or a type database file (@see TypeDatabase),
 /// this class can correctly read binary memory data for any known C types,
 /// and print out in readable text field by field
 ///
+/// The definitions are always read from a type database, which is built in memory when a TypeParser is given
+///
 /// @author Frank Fang (fanghm@gmail.com)
 /// @date   2013/07/06
 ///
@@ -26,17 +33,78 @@ public:
     /// memory data comes from binary file
     DataReader(const TypeParser& parser, const string &data_file);
 
+    /// same as above, but the type definitions come from an opened type database
+    DataReader(const TypeDatabase& types, char* buffer, size_t size);
+    DataReader(const TypeDatabase& types, const string &data_file);
+
     ~DataReader(void);
 
     /// print the type fields and their values in a nicely fomatted way
-    void PrintTypeData(const string &type_name, bool is_union = false);
+    /// the data is read from where the last call stops, so the records of a dump are printed one by one,
+    /// or @p count of them at once
+    void PrintTypeData(const string &type_name, bool is_union = false, size_t count = 1);
     
 private:
-	void PrepareTypeData(const string &type_name, size_t indent, bool is_union);
+    /// @brief A step of a decoding plan, @see Plan
+    typedef struct {
+        uint32_t    op;         ///< PlanOp
+        uint32_t    flags;      ///< @see PlanFlags
+        uint32_t    depth;      ///< depth of indent
+        uint32_t    offset;     ///< of a value from the start of the record
+        uint32_t    size;       ///< of a value in bytes
+        uint32_t    index;      ///< of an array element
+        uint32_t    enum_first; ///< enumerators of an enum value
+        uint32_t    enum_count;
+        uint32_t    shift;      ///< of a bitfield in the word loaded at the offset, less than 8
+        unsigned long long mask;    ///< of the bits of a value, after the shift for a bitfield
+        StringView  name;       ///< member name of the label, @see PlanFlags
+        StringView  text;       ///< type name of kOpenStruct/kOpenUnion and the errors
+    } PlanStep;
+
+    enum PlanOp {
+        kOpenStruct,            ///< [label] struct name {
+        kOpenUnion,             ///< [label] union name {
+        kClose,                 ///< }
+        kOpenArray,             ///< name = [
+        kCloseArray,            ///< ]
+        kValue,                 ///< [label] value
+        kUnknownType,           ///< [label] and an error, the struct/union isn't defined
+        kUnresolvedType,        ///< [label] and an error, the member type isn't known
+        kRecursiveType          ///< [label] and an error, the struct/union contains itself
+    };
+
+    enum PlanFlags {
+        kLabelMember    = 1,    ///< the step starts with "name = "
+        kLabelElement   = 2,    ///< the step starts with "[index] = "
+        kCharValue      = 4,    ///< the value is printed as a char too
+        kEnumValue      = 8,    ///< the value is printed with its enumerator name
+        kBitfieldValue  = 16,   ///< the value is extracted by the shift and mask from the word at the offset
+        kSignedValue    = 32    ///< the highest bit of the mask is the sign
+    };
+
+    /// @brief The flat decoding plan of a type
+    ///
+    /// A type is compiled once into the list of steps printing a record of it, with the absolute offset of
+    /// each value in the record, so a record is decoded by a single loop over the steps; the member lists,
+    /// the nested types and the names aren't looked up again
+    typedef struct {
+        vector<PlanStep>    steps;
+        uint32_t            size;   ///< bytes of a record
+        uint32_t            values; ///< number of kValue steps
+    } Plan;
 
-    void PrintMemberData(list<VariableDeclaration>& members, size_t indent, bool is_union);
-    void PrintVarData(const VariableDeclaration &def, size_t indent, bool is_union);
-    void PrintVarValue(const VariableDeclaration &var_def, size_t indent, bool is_union);
+    void Initialize();
+
+    const Plan *GetPlan(const TypeDatabase::TypeRecord &type, bool is_union);
+    void CompileType(const TypeDatabase::TypeRecord &type, bool is_union, uint32_t offset, PlanStep label,
+                     Plan &plan);
+    void CompileMember(const TypeDatabase::MemberRecord &member, uint32_t offset, uint32_t depth, Plan &plan);
+    void CompileValue(const TypeDatabase::MemberRecord &member, uint32_t size, uint32_t offset, PlanStep label,
+                      Plan &plan);
+
+    void PrintRecord(const Plan &plan);
+    void PrintLabel(const PlanStep &step);
+    void PrintValue(const PlanStep &step, const char *record);
 
     /// read data from binary data file
     void ReadData(const string &data_file);
@@ -46,7 +114,16 @@ private:
     //char* getData() { return data_buffer_; }
 
 private:
-    TypeParser		type_parser_;
+    TypeDatabase        own_types_;     ///< built from the TypeParser if it's given
+    const TypeDatabase  &types_;
+    const TypeDatabase::TypeRecord *char_type_;
+    set<const TypeDatabase::TypeRecord *> signed_types_;    ///< the basic types printed signed
+
+    /// the plans compiled so far, by type and whether it's read as a union
+    map<pair<const TypeDatabase::TypeRecord *, bool>, Plan> plans_;
+
+    /// the struct/union types being compiled, from the outermost, @see CompileType
+    vector<const TypeDatabase::TypeRecord *> compiling_;
 
     char*			data_buffer_;   ///< buffer to hold the content of the binary memory dump file
     size_t			data_size_;		///< total size of @var data_buffer
@@ -0,0 +1,91 @@
+#ifndef _DIRECTORY_CRAWLER_H_
+#define _DIRECTORY_CRAWLER_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Find the files under a folder recursively on multiple threads
+///
+/// The folders to read are kept in one stack shared by the workers: a worker reads a whole folder, then
+/// pushes the sub-folders it met and takes the next folder, so the lock is taken once per folder.
+/// The entry types come from readdir (d_type), an entry is only stat-ed when the file system doesn't tell.
+/// Threads are only available with pthreads, the folders are read one by one on the caller thread otherwise
+///
+/// What a folder contains can be kept from a previous crawl along with the folder's stamp (modified time,
+/// inode and size). A folder whose stamp is not changed is not read again: adding, removing or renaming an
+/// entry changes the modified time of the folder, so one stat tells whether the kept content is still valid
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+class DirectoryCrawler
+{
+public:
+    /// @brief A file found
+    typedef struct {
+        string  name;       ///< name relative to the crawled folder, e.g. "sub/dir.h"
+        size_t  position;   ///< which readdir call returns it in its folder, starting from 1
+    } Entry;
+
+    /// @brief Identity and modified time of a folder
+    typedef struct {
+        long long   mtime;          ///< in seconds
+        long long   mtime_nsec;     ///< nanoseconds part of the modified time, 0 if not supported
+        long long   inode;
+        long long   size;
+    } FolderStamp;
+
+    /// @brief What a folder contains, the files and sub-folders are filtered already
+    typedef struct {
+        FolderStamp     stamp;      ///< taken before the folder is read
+        size_t          calls;      ///< number of readdir calls to read it through
+        vector<Entry>   files;
+        vector<string>  folders;    ///< relative to the crawled folder
+    } Folder;
+
+    /// key - folder relative to the crawled folder, empty for the crawled folder itself
+    typedef map<string, Folder> FolderMap;
+
+    DirectoryCrawler(void);
+
+    /// only report the files ending with one of the extensions, e.g. ".h"; all files are reported if it's empty
+    void SetExtensions(const vector<string> &extensions) { extensions_ = extensions; }
+
+    /// skip the files and folders matching one of the patterns, a folder excluded is not read at all
+    /// a pattern is matched with both the relative name and the base name, @see MatchGlob
+    void SetExcludes(const vector<string> &excludes) { excludes_ = excludes; }
+
+    const vector<string> &extensions() const { return extensions_; }
+    const vector<string> &excludes() const { return excludes_; }
+
+    /// find the files under a folder
+    /// @param[in]  threads     maximum number of threads including the caller thread
+    /// @param[out] files       the files found, sorted by name
+    /// @param[in,out]  folders the folders known from a previous crawl with the same extensions and excludes,
+    ///                     which are replaced by the folders found; NULL to read all the folders
+    /// @return number of readdir calls that read the folder itself, including the last one returning nothing;
+    ///         0 if the folder cannot be opened
+    size_t Crawl(const string &folder, size_t threads, vector<Entry> &files, FolderMap *folders = NULL) const;
+
+    /// match a name with a glob pattern, '*' matches any characters and '?' matches any one character
+    static bool MatchGlob(const char *pattern, const char *name);
+
+private:
+    struct CrawlState;
+
+    static void *Work(void *state);
+    size_t ReadFolder(const string &root, const string &relative, Folder &folder, vector<string> &errors) const;
+    static bool StatFolder(const string &path, FolderStamp &stamp);
+    bool IsExcluded(const string &relative, const char *base_name) const;
+    bool HasExtension(const char *name) const;
+
+    vector<string> extensions_;
+    vector<string> excludes_;
+};
+
+#endif  // _DIRECTORY_CRAWLER_H_
@@ -0,0 +1,69 @@
+#ifndef _INCLUDE_INDEX_H_
+#define _INCLUDE_INDEX_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Index of the files under the include paths
+///
+/// Each include path is crawled once, and every file under it is indexed by its name relative to the path,
+/// e.g. "a.h" or "sub/dir.h". Resolving an #include is then a single hash probe instead of reading the
+/// include paths again for every inclusion.
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <string>
+#include <vector>
+
+#include "SymbolTable.h"
+#include "DirectoryCrawler.h"
+
+using namespace std;
+
+class IncludeIndex
+{
+public:
+    IncludeIndex(void);
+
+    /// find the files under an include path recursively and index them
+    /// @param[in]  crawler     which files to index, @see DirectoryCrawler
+    /// @param[in]  threads     maximum number of threads to read the folders
+    /// @param[out] files       the files found, prefixed with the path, sorted by name
+    /// @param[in,out]  folders the folders of the path known from a previous run, @see DirectoryCrawler::Crawl
+    /// @note when a name is under more than one path, the path added first wins
+    void AddPath(const string &folder, const DirectoryCrawler &crawler, size_t threads, vector<string> &files,
+                 DirectoryCrawler::FolderMap *folders = NULL);
+
+    /// get the path of an included file
+    /// @param[in]  name    name relative to an include path, e.g. "sub/dir.h"
+    /// @return empty string if it's not under any include path
+    string Find(const string &name);
+
+    /// number of calls to @method Find
+    size_t lookups() const { return lookups_; }
+
+    /// number of opendir/readdir/closedir calls that scanning the include paths for each lookup would have made
+    size_t saved_syscalls() const { return saved_syscalls_; }
+
+private:
+    /// @brief Where an indexed file is
+    typedef struct {
+        size_t  path;       ///< index of the include path in @var paths_
+        size_t  position;   ///< which readdir call returns it in the top folder of the path, 0 if it's nested
+    } Entry;
+
+    /// @brief An include path
+    typedef struct {
+        string  folder;
+        size_t  scan_cost;  ///< number of calls to read the top folder through, 1 if it cannot be opened
+    } Path;
+
+    SymbolTable     names_;     ///< relative names of the files
+    vector<Entry>   entries_;   ///< index - id of the name
+    vector<Path>    paths_;
+
+    size_t lookups_;
+    size_t saved_syscalls_;
+};
+
+#endif  // _INCLUDE_INDEX_H_
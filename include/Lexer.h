@@ -0,0 +1,75 @@
+#ifndef _LEXER_H_
+#define _LEXER_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Single pass lexer for C header files
+///
+/// It turns the raw content of a header file into tokens in one forward pass:
+///     - line comments and comment blocks are skipped
+///     - wrapped lines (ending with '\') are joined
+///     - each token is marked when it starts a new logical line, where a logical line ends at a line break,
+///       or after ',' and ';' except in pre-processing directives and after ',' within parentheses, e.g. of
+///       __attribute__((packed, aligned(4)))
+///
+/// The output of a preprocessor (e.g. gcc -E) has neither comments nor wrapped lines, so only blanks are
+/// skipped between the tokens when the input is known to be preprocessed
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <vector>
+
+#include "StringView.h"
+
+using namespace std;
+
+/// @brief A token within the source buffer
+typedef struct {
+    StringView  text;           ///< characters of the token, referring to the source buffer
+    bool        line_start;     ///< true when it's the first token of a logical line
+} Token;
+
+typedef vector<Token> TokenList;
+
+/// @brief A range of tokens [begin, end) within a token list, usually a logical line
+typedef struct {
+    size_t  begin;
+    size_t  end;
+} TokenRange;
+
+class Lexer
+{
+public:
+    /// @param[in]  data    source buffer, it must outlive the tokens
+    /// @param[in]  size    size of the source buffer
+    /// @param[in]  preprocessed    whether the source is the output of a preprocessor
+    Lexer(const char *data, size_t size, bool preprocessed = false);
+
+    /// get the next token
+    /// @return false when the end of source is reached
+    bool Next(Token &token);
+
+    /// append all the (rest) tokens to the list
+    /// @return number of tokens appended
+    size_t Tokenize(TokenList &tokens);
+
+    /// underline ('_') shouldn't be included as it can be part of an identifier
+    static const char *const kTokenDelimiters;
+
+private:
+    void SkipBlanksAndComments();
+    void SkipBlanks();
+
+private:
+    const char *cur_;           ///< current position in the source buffer
+    const char *end_;           ///< end of the source buffer
+    bool preprocessed_;         ///< no comments or wrapped lines to look for
+
+    bool line_start_;           ///< the next token starts a new logical line
+    bool in_directive_;         ///< within a pre-processing directive line
+    bool in_quotation_;         ///< within a string literal, where comment marks are not recognized
+    size_t paren_depth_;        ///< depth of the parentheses out of directives, it's reset by ';'
+};
+
+#endif  // _LEXER_H_
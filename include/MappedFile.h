@@ -0,0 +1,51 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Read-only view of a whole file's content
+///
+/// Regular files are memory mapped so that their bytes can be used in place without any copy;
+/// pipes and special files (or when mapping fails) are read into a buffer instead
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <string>
+
+using namespace std;
+
+class MappedFile
+{
+public:
+    MappedFile(void);
+    ~MappedFile(void);
+
+    /// open a file and make its content available
+    /// @return false if the file cannot be opened or read
+    bool Open(const string &file);
+
+    /// release the content, it's also done when the object is destructed
+    void Close();
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+    /// true if the content is mapped, false if it's read into a buffer
+    bool is_mapped() const { return mapped_; }
+
+private:
+    bool ReadAll(int fd);
+
+    // not copyable as the mapping is owned
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+private:
+    const char *data_;  ///< file content, either mapped or pointing to @var buffer_
+    size_t      size_;  ///< size of the content in bytes
+    bool        mapped_;
+    string      buffer_;    ///< content read by read() when the file cannot be mapped
+};
+
+#endif  // _MAPPED_FILE_H_
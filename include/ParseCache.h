@@ -0,0 +1,85 @@
+#ifndef _PARSE_CACHE_H_
+#define _PARSE_CACHE_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// On-disk cache of parsing results
+///
+/// The result of parsing a header file is a log of the changes it made to the type definitions,
+/// @see TypeParser::Record. The log is stored in the cache folder under a key, which is made by the parser
+/// from the hash of the file content and the state of the definitions before the file is parsed.
+///
+/// Hashing a file still needs to read it, so the cache also keeps an index of the content hashes along with
+/// the modified time and size of the files: as long as they're not changed, the file is not read at all.
+/// A file modified when the index was written, or after, may have been changed again within the resolution
+/// of the modified time, so it's "racy" and hashed again, like the racy entries of the git index.
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <string>
+#include <map>
+
+using namespace std;
+
+/// 64-bit hash value
+typedef unsigned long long CacheKey;
+
+class ParseCache
+{
+public:
+    ParseCache(void);
+    ~ParseCache(void);
+
+    /// use a folder as the cache, it's created when not existing
+    /// @return false if the folder cannot be used
+    bool Open(const string &folder);
+
+    bool is_open() const { return !folder_.empty(); }
+
+    /// get the content hash of a file from the index
+    /// @return false if the file is unknown, or it's modified since it's hashed
+    bool FindContentHash(const string &file, CacheKey &hash) const;
+
+    /// update the content hash of a file in the index
+    void SetContentHash(const string &file, CacheKey hash);
+
+    /// load or store a parsing result
+    bool Load(CacheKey key, string &log) const;
+    bool Store(CacheKey key, const string &log) const;
+
+    /// load or store any other file in the cache folder, e.g. "manifest"
+    bool LoadFile(const string &name, string &content) const;
+    bool StoreFile(const string &name, const string &content) const;
+
+    /// write the index back into the cache folder if it's changed, it's also done when the object is destructed
+    void Save();
+
+    /// FNV-1a hash, @var seed can be a previous hash value to chain the data
+    static CacheKey Hash(const char *data, size_t size, CacheKey seed = kHashSeed);
+    static CacheKey Hash(const string &data, CacheKey seed = kHashSeed) { return Hash(data.data(), data.length(), seed); }
+
+    static const CacheKey kHashSeed = 14695981039346656037ULL;
+
+private:
+    /// @brief An entry of the index
+    typedef struct {
+        long long   mtime;      ///< modified time of the file when it's hashed
+        long long   mtime_nsec;
+        long long   size;       ///< size of the file when it's hashed
+        CacheKey    hash;       ///< hash of the file content
+        bool        hashed;     ///< hashed by this process, so it's never racy
+    } FileStamp;
+
+    static bool Stat(const string &file, FileStamp &stamp);
+    bool IsRacy(const FileStamp &stamp) const;
+    static string NameOf(CacheKey key);
+    static bool WriteFile(const string &path, const string &content);
+
+    string folder_;
+    map <string, FileStamp> index_;     ///< key - file name that's used to parse the file
+    FileStamp index_stamp_;             ///< modified time of the index when it's loaded, 0 for none
+    bool dirty_;                        ///< whether the index is changed since it's loaded
+};
+
+#endif  // _PARSE_CACHE_H_
@@ -0,0 +1,130 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Timers and counters of the processing phases
+///
+/// The time of a phase is measured with a monotonic clock by a Stats::Scope. Phases nest, e.g. a file is
+/// tokenized and parsed while an #include directive is preprocessed: the enclosing phase is paused meanwhile,
+/// so each phase gets its own time only and the times add up to the whole run.
+///
+/// The phases and counters are only touched by the thread running the parser or the reader, the work done
+/// on the worker threads is timed and counted as a whole by the caller. Allocations are the exception,
+/// they're counted on every thread.
+///
+/// Optionally the hardware events of each phase (cycles, instructions, cache misses...) are counted as well,
+/// with perf_event_open on Linux. They're read whenever the phase changes, so it costs a few system calls
+/// per phase entered. An event that cannot be counted, e.g. in a virtual machine or when it's not permitted
+/// by perf_event_paranoid, is reported as not available, and the times are always reported.
+///
+/// The name lookups and the allocations are on the hottest paths, they're only counted in a build with
+/// STATS_HOT_COUNTERS defined, like the benchmarks; counting the allocations replaces the global operator new.
+/// Otherwise they're reported as not available too.
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <iostream>
+
+using namespace std;
+
+class Stats
+{
+public:
+    enum Phase {
+        kDiscovery,         ///< finding the header files under the include paths
+        kTokenizing,        ///< reading and tokenizing the header files
+        kCache,             ///< hashing the header files, loading and replaying cached results
+        kPreprocessing,     ///< #include, #define and other directives
+        kParsing,           ///< declarations
+        kLayout,            ///< padding, sizes and alignments of the types
+        kDecoding,          ///< reading binary data with the types
+        kPhaseCount
+    };
+
+    enum Counter {
+        kFiles,             ///< header files read
+        kBytes,             ///< bytes of the header files read
+        kTokens,
+        kDirectives,
+        kDeclarations,      ///< struct/union/enum definitions and constants stored
+        kLookups,           ///< name lookups in the symbol tables and the type database, @see AddHot
+        kAllocations,       ///< calls to operator new, with STATS_HOT_COUNTERS only
+        kRecordsDecoded,    ///< records read from binary data
+        kCounterCount
+    };
+
+    enum Event {
+        kCycles,
+        kInstructions,
+        kCacheMisses,       ///< last level cache misses
+        kBranchMisses,
+        kPageFaults,
+        kEventCount
+    };
+
+    /// @brief Time a phase during its lifetime
+    class Scope {
+    public:
+        explicit Scope(Phase phase);
+        ~Scope();
+
+    private:
+        Phase   previous_;  ///< the enclosing phase, kPhaseCount for none
+    };
+
+    static void Add(Counter counter, unsigned long long count = 1) { counters_[counter] += count; }
+
+    /// count on a hot path, it's compiled out unless STATS_HOT_COUNTERS is defined
+    static void AddHot(Counter counter) {
+#ifdef STATS_HOT_COUNTERS
+        ++counters_[counter];
+#else
+        (void)counter;
+#endif
+    }
+
+    /// count an allocation, it can be called on any thread
+    static void AddAllocation();
+
+    /// whether a counter is counted in this build, @see AddHot
+    static bool has_counter(Counter counter);
+    static unsigned long long counter(Counter counter);
+    static double seconds(Phase phase) { return seconds_[phase]; }
+
+    /// start counting the hardware events on the calling thread and the threads it creates afterwards,
+    /// whose events are added to the phase that's current when they end
+    /// @return false if none of the events can be counted
+    static bool EnableEvents();
+
+    /// whether an event is counted, @see EnableEvents
+    static bool has_event(Event event) { return event_fds_[event] >= 0; }
+    static unsigned long long events(Phase phase, Event event) { return events_[phase][event]; }
+
+    /// clear the times and counters, it must not be called within a phase
+    static void Reset();
+
+    /// print the phases and counters as a table, or as a JSON object
+    static void Print(ostream &os, bool json = false);
+
+    /// seconds from a fixed point in the past, never going backwards
+    static double Now();
+
+private:
+    static void Switch(Phase phase);
+    static void ReadEvents(unsigned long long values[kEventCount]);
+
+    static Phase                current_;
+    static double               start_;     ///< when @var current_ is entered or resumed
+    static double               seconds_[kPhaseCount];
+    static unsigned long long   entries_[kPhaseCount];
+    static unsigned long long   counters_[kCounterCount];
+
+    static bool                 events_enabled_;
+    static int                  event_fds_[kEventCount];    ///< -1 for the events not counted
+    static unsigned long long   event_start_[kEventCount];  ///< values when @var current_ is entered or resumed
+    static unsigned long long   events_[kPhaseCount][kEventCount];
+};
+
+#endif  // _STATS_H_
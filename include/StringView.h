@@ -0,0 +1,101 @@
+#ifndef _STRING_VIEW_H_
+#define _STRING_VIEW_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Non-owning reference to a range of characters
+///
+/// Tokens and lines are handed out by the parser as views into the source buffer,
+/// so that no string is allocated for them unless the caller wants to keep a copy
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <string.h>     // memcmp, memchr, strlen
+#include <assert.h>
+#include <string>
+#include <ostream>
+
+using namespace std;
+
+class StringView
+{
+public:
+    StringView(void) : data_(NULL), length_(0) {}
+    StringView(const char *data, size_t length) : data_(data), length_(length) {}
+    StringView(const char *str) : data_(str), length_(strlen(str)) {}
+    StringView(const string &str) : data_(str.data()), length_(str.length()) {}
+
+    const char *data() const { return data_; }
+    size_t length() const { return length_; }
+    bool empty() const { return 0 == length_; }
+
+    char operator[](size_t i) const { return data_[i]; }
+    char at(size_t i) const { assert(i < length_); return data_[i]; }
+
+    /// make a copy of the referenced characters
+    string str() const { return string(data_, length_); }
+
+    /// @see string::substr, the returned view refers to the same characters
+    StringView substr(size_t pos, size_t n = string::npos) const {
+        assert(pos <= length_);
+        return StringView(data_ + pos, (n > length_ - pos) ? length_ - pos : n);
+    }
+
+    /// @see string::find
+    size_t find(char ch, size_t pos = 0) const {
+        if (pos >= length_) return string::npos;
+
+        const void *p = memchr(data_ + pos, ch, length_ - pos);
+        return (NULL == p) ? string::npos : static_cast<const char *>(p) - data_;
+    }
+
+    /// @see string::rfind
+    size_t rfind(char ch, size_t pos = string::npos) const {
+        if (0 == length_) return string::npos;
+
+        for (size_t i = (pos < length_) ? pos + 1 : length_; i > 0; --i) {
+            if (ch == data_[i - 1]) return i - 1;
+        }
+        return string::npos;
+    }
+
+    /// @see string::find_first_of
+    size_t find_first_of(const StringView &chars, size_t pos = 0) const {
+        for (; pos < length_; ++pos) {
+            if (NULL != memchr(chars.data_, data_[pos], chars.length_)) return pos;
+        }
+        return string::npos;
+    }
+
+    /// @see string::compare
+    int compare(const StringView &other) const {
+        size_t len = (length_ < other.length_) ? length_ : other.length_;
+        int ret = (0 == len) ? 0 : memcmp(data_, other.data_, len);
+
+        if (0 != ret) return ret;
+        return (length_ == other.length_) ? 0 : (length_ < other.length_ ? -1 : 1);
+    }
+
+private:
+    const char *data_;  ///< first referenced character, not necessarily null-terminated
+    size_t length_;     ///< number of referenced characters
+};
+
+inline bool operator==(const StringView &lhs, const StringView &rhs) {
+    return lhs.length() == rhs.length() && 0 == lhs.compare(rhs);
+}
+
+inline bool operator!=(const StringView &lhs, const StringView &rhs) {
+    return !(lhs == rhs);
+}
+
+inline bool operator<(const StringView &lhs, const StringView &rhs) {
+    return lhs.compare(rhs) < 0;
+}
+
+inline ostream &operator<<(ostream &os, const StringView &view) {
+    return os.write(view.data(), view.length());
+}
+
+#endif  // _STRING_VIEW_H_
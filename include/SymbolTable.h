@@ -0,0 +1,87 @@
+#ifndef _SYMBOL_TABLE_H_
+#define _SYMBOL_TABLE_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Interned identifiers
+///
+/// Every identifier (type names, member names, constants, keywords) is stored once and given a dense id,
+/// so that the type definitions refer to ids instead of keeping their own copies of the names,
+/// and looking up a name becomes an integer comparison
+///
+/// It's also the type registry: each id carries a SymbolInfo telling what the name stands for,
+/// so a single probe answers whether a token is a keyword, a qualifier or a type, and the type's size
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <assert.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <utility>  // pair
+
+#include "defines.h"
+#include "StringView.h"
+
+using namespace std;
+
+/// @brief What an identifier stands for
+///
+/// The definitions are owned by TypeParser, here're only pointers to them
+typedef struct {
+    TokenTypes  kind;           ///< kUnresolvedToken for identifiers that are not keywords/qualifiers/types
+    bool        has_size;       ///< whether it's a type with known size
+    size_t      size;           ///< size of the type in bytes
+    size_t      align;          ///< alignment of the type in bytes
+
+    const vector<VariableDeclaration>   *struct_def;    ///< members when it's a struct name, else NULL
+    const vector<VariableDeclaration>   *union_def;     ///< members when it's a union name, else NULL
+    const list< pair<SymbolId, int> >   *enum_def;      ///< enumerators when it's a enum name, else NULL
+} SymbolInfo;
+
+class SymbolTable
+{
+public:
+    SymbolTable(void);
+
+    /// get the id of a name, the name is added when it's not yet known
+    SymbolId Intern(const StringView &name);
+
+    /// get the id of a name
+    /// @return kNoSymbol if the name is not known
+    SymbolId Find(const StringView &name) const;
+
+    /// get the name of an id
+    /// @note the returned view is only valid until the next call of @method Intern
+    StringView Name(SymbolId id) const;
+
+    /// number of interned names, including the empty name with id kNoSymbol
+    size_t size() const { return entries_.size(); }
+
+    /// what the name stands for, an unknown name gets the info of kNoSymbol (unresolved, no size)
+    const SymbolInfo &Lookup(const StringView &name) const { return infos_[Find(name)]; }
+
+    const SymbolInfo &Info(SymbolId id) const { return (id < infos_.size()) ? infos_[id] : infos_[kNoSymbol]; }
+    SymbolInfo &Info(SymbolId id) { assert(kNoSymbol != id && id < infos_.size()); return infos_[id]; }
+
+private:
+    size_t Probe(const StringView &name, unsigned int hash) const;
+    void Grow();
+
+    static unsigned int Hash(const StringView &name);
+
+private:
+    typedef struct {
+        size_t          offset;     ///< position of the name in @var pool_
+        size_t          length;     ///< length of the name
+        unsigned int    hash;       ///< hash of the name, kept for rehashing
+    } Entry;
+
+    string          pool_;      ///< all the names one after another
+    vector<Entry>   entries_;   ///< index - id
+    vector<SymbolInfo> infos_;  ///< index - id
+    vector<SymbolId> slots_;    ///< open addressing hash table of ids, kNoSymbol for empty slots
+};
+
+#endif  // _SYMBOL_TABLE_H_
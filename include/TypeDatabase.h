@@ -0,0 +1,177 @@
+#ifndef _TYPE_DATABASE_H_
+#define _TYPE_DATABASE_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Flat binary database of the parsed type definitions
+///
+/// The whole parsed state of TypeParser (types with their sizes, struct/union members, enum members and constants)
+/// is written into one file made of fixed size records, which refer to each other by indices and offsets instead
+/// of pointers. So the file can be mapped and used in place: all the processes decoding data on a host share
+/// the same page-cached copy, and none of them needs to parse the header files or to deserialize anything.
+///
+/// File layout, all the numbers are 32-bit in the byte order of the writer (@see LayoutFingerprint):
+///     Header
+///     TypeRecord[type_count]
+///     MemberRecord[member_count]          struct/union members
+///     EnumeratorRecord[enumerator_count]  enum members
+///     ConstantRecord[constant_count]
+///     uint32_t[hash_slots]                open addressing hash table of type names, type index + 1, 0 for empty
+///     char[string_size]                   names, not null-terminated
+///
+/// Everything is validated once when a database is opened, the accessors don't check anything afterwards:
+/// the indices and names are in bounds, the members lie within their types, and no type contains itself
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <stdint.h>
+#include <string>
+
+#include "defines.h"
+#include "StringView.h"
+#include "MappedFile.h"
+
+using namespace std;
+
+class TypeParser;
+
+class TypeDatabase
+{
+public:
+    static const uint32_t kVersion = 5;
+    static const uint32_t kNoType = 0xffffffff;     ///< type index of an unknown type
+
+    /// @brief A name in the string area
+    typedef struct {
+        uint32_t    offset;
+        uint32_t    length;
+    } NameRef;
+
+    /// @brief A type name and what it stands for, @see SymbolInfo
+    typedef struct {
+        NameRef     name;
+        uint32_t    kind;           ///< TokenTypes
+        uint32_t    flags;          ///< kAnonymousType, kStructDefined, kUnionDefined, kEnumDefined
+        uint32_t    size;
+        uint32_t    align;
+        uint32_t    struct_first;   ///< struct members, index of the first one in the member records
+        uint32_t    struct_count;   ///< number of struct members, 0 if it's not a struct
+        uint32_t    union_first;
+        uint32_t    union_count;
+        uint32_t    enum_first;     ///< index of the first enum member in the enumerator records
+        uint32_t    enum_count;
+    } TypeRecord;
+
+    /// @brief A struct/union member, @see VariableDeclaration
+    typedef struct {
+        NameRef     name;
+        NameRef     type_name;      ///< name of its data type, which can be unknown
+        uint32_t    type;           ///< index of its data type, or kNoType
+        uint32_t    flags;          ///< kPointerMember, kBitfieldMember, kUnsignedMember
+        uint32_t    array_size;     ///< 0 for non-array
+        uint32_t    size;           ///< size in bytes, the size of its type for a bitfield
+        uint32_t    offset;         ///< offset in bytes in its struct/union, the gaps between the members are padding
+        uint32_t    bit_offset;     ///< first bit of a bitfield from the offset, the lowest bit is 0
+        uint32_t    bit_width;      ///< width in bits of a bitfield, 0 for other members
+    } MemberRecord;
+
+    typedef struct {
+        NameRef     name;
+        int32_t     value;
+    } EnumeratorRecord;
+
+    typedef struct {
+        NameRef     name;
+        uint32_t    value_low;      ///< the value is a 64-bit signed integer split into 2 parts
+        uint32_t    value_high;
+    } ConstantRecord;
+
+    /// flags of TypeRecord
+    static const uint32_t kAnonymousType = 1;   ///< the name is made up for an anonymous type
+    static const uint32_t kStructDefined = 2;   ///< there's a struct definition with the name, maybe empty
+    static const uint32_t kUnionDefined  = 4;
+    static const uint32_t kEnumDefined   = 8;
+
+    /// flags of MemberRecord
+    static const uint32_t kPointerMember = 1;
+    static const uint32_t kBitfieldMember = 2;  ///< the name is empty for an unnamed bitfield
+    static const uint32_t kUnsignedMember = 4;  ///< declared unsigned, which isn't in the type name
+
+public:
+    TypeDatabase(void);
+
+    /// make the database image of the parsing result
+    static void Build(const TypeParser &parser, string &image);
+
+    /// write the parsing result into a database file
+    static bool Write(const TypeParser &parser, const string &file);
+
+    /// map a database file and validate it
+    bool Open(const string &file);
+
+    /// use a database image in memory, it's copied
+    bool Open(const char *data, size_t size);
+
+    bool is_open() const { return NULL != header_; }
+
+    /// @return NULL if not found
+    const TypeRecord *FindType(const StringView &name) const;
+
+    /// @return false if not found
+    bool FindConstant(const StringView &name, long &value) const;
+
+    size_t type_count() const { return header_->type_count; }
+    size_t constant_count() const { return header_->constant_count; }
+
+    const TypeRecord &type(uint32_t index) const { return types_[index]; }
+    const MemberRecord &member(uint32_t index) const { return members_[index]; }
+    const EnumeratorRecord &enumerator(uint32_t index) const { return enumerators_[index]; }
+    const ConstantRecord &constant(uint32_t index) const { return constants_[index]; }
+
+    StringView Name(const NameRef &name) const { return StringView(strings_ + name.offset, name.length); }
+
+private:
+    typedef struct {
+        char        magic[8];
+        uint32_t    version;
+        uint32_t    fingerprint;    ///< @see LayoutFingerprint
+        uint32_t    file_size;
+
+        uint32_t    type_count;
+        uint32_t    member_count;
+        uint32_t    enumerator_count;
+        uint32_t    constant_count;
+        uint32_t    hash_slots;     ///< a power of 2
+        uint32_t    string_size;
+    } Header;
+
+    static uint32_t LayoutFingerprint();
+    static uint32_t Hash(const StringView &name);
+
+    bool Validate();
+    bool IsValidName(const NameRef &name) const;
+    bool IsValidMember(const TypeRecord &owner, const MemberRecord &member) const;
+    bool IsAcyclic() const;
+
+    // not copyable as the pointers refer to its own content
+    TypeDatabase(const TypeDatabase &);
+    TypeDatabase &operator=(const TypeDatabase &);
+
+private:
+    MappedFile  file_;
+    string      image_;     ///< content opened from memory, it must be aligned for the records
+
+    const char  *data_;
+    size_t      size_;
+
+    const Header            *header_;   ///< NULL until a valid database is opened
+    const TypeRecord        *types_;
+    const MemberRecord      *members_;
+    const EnumeratorRecord  *enumerators_;
+    const ConstantRecord    *constants_;
+    const uint32_t          *slots_;
+    const char              *strings_;
+};
+
+#endif  // _TYPE_DATABASE_H_
@@ -12,6 +12,8 @@
 ///     - struct/union/enum definition of all valid formats, including nested struct/union
 ///     - global variable definition
 ///     - one demension array
+///     - struct/union layouts of a target ABI, @see Abi
+///     - #pragma pack, and the packed/aligned attributes of structs, unions and their members
 ///
 /// @author Frank Fang (fanghm@gmail.com)
 /// @date   2013/07/06
@@ -24,12 +26,20 @@
 #include <set>
 
 #include "defines.h"
+#include "Abi.h"
+#include "StringView.h"
+#include "Lexer.h"
+#include "MappedFile.h"
+#include "ParseCache.h"
+#include "SymbolTable.h"
+#include "IncludeIndex.h"
 
 
 class TypeParser
 {
 /// add this friend class so that the type definitions can be used by it to parse the log data
 friend class DataReader;
+friend class TypeDatabase;
 
 public:
     TypeParser(void);
@@ -37,85 +47,204 @@ public:
     
     void ParseFiles();
     void ParseFile(const string &file);
+
+    /// parse the output of a preprocessor, e.g. gcc -E -dD, which is a whole translation unit in a single file
+    /// the numeric macros come from the #define lines kept by -dD, and the line markers tell which files
+    /// the lines come from; the include paths are not needed
+    void ParsePreprocessedFile(const string &file);
     void ParseSource(const string &src);
+    void ParseSource(const char *src, size_t size);
+
+    /// print all the type definitions parsed so far
+    void DumpTypeDefs() const;
 
     void SetIncludePaths(set <string> paths);
 
+    /// number of threads to find, read and tokenize the header files in @method ParseFiles, 1 by default
+    void SetJobs(size_t jobs) { jobs_ = (jobs > 0) ? jobs : 1; }
+
+    /// keep the parsing results in a folder and reuse them in later runs, @see ParseCache
+    bool SetCacheFolder(const string &folder) { return cache_.Open(folder); }
+
+    /// extensions of the header files under the include paths, only ".h" by default
+    void SetHeaderExtensions(const vector<string> &extensions) { crawler_.SetExtensions(extensions); }
 
+    /// glob patterns of the files and folders to skip under the include paths, @see DirectoryCrawler
+    void SetExcludes(const vector<string> &patterns) { crawler_.SetExcludes(patterns); }
 
-    string MergeAllLines(const list<string> &lines) const;
-    bool GetNextToken(string src, size_t &pos, string &token, bool cross_line = true) const;
-    bool GetNextLine(string src, size_t &pos, string &line) const;
-    bool GetRestLine(const string &src, size_t &pos, string &line) const;
-    void SkipCurrentLine(const string &src, size_t &pos, string &line) const;
-    size_t SplitLineIntoTokens(string line, vector<string> &tokens) const;
+    /// the ABI the types are laid out for, ilp32 by default
+    /// the types parsed already are laid out again, so the layouts of several ABIs come from a single parse
+    void SetAbi(const Abi &abi);
+    const Abi &abi() const { return abi_; }
+
+
+
+    bool GetNextToken(const TokenList &src, size_t &pos, StringView &token, bool cross_line = true) const;
+    bool GetQuotedText(const TokenList &src, size_t &pos, StringView &text) const;
+    bool GetNextLine(const TokenList &src, size_t &pos, TokenRange &line) const;
+    bool GetRestLine(const TokenList &src, size_t &pos, TokenRange &line) const;
+    void SkipCurrentLine(const TokenList &src, size_t &pos, TokenRange &line) const;
+    size_t SplitLineIntoTokens(const TokenList &src, const TokenRange &line, vector<StringView> &tokens) const;
     
-    bool ParseDeclaration(const string &line, VariableDeclaration &decl) const;
-    bool ParseEnumDeclaration(const string &line, int &last_value, pair<string, int> &decl, bool &is_last_member) const;
-    bool ParseAssignExpression(const string &line);
+    bool ParseDeclaration(const vector<StringView> &tokens, VariableDeclaration &decl) const;
+    bool ParseBitfield(const vector<StringView> &tokens, VariableDeclaration &decl) const;
+    bool ParseEnumDeclaration(const vector<StringView> &tokens, int &last_value, pair<SymbolId, int> &decl, bool &is_last_member) const;
+    bool ParseAssignExpression(const vector<StringView> &tokens);
+
+    void ParseTokens(const TokenList &src);
+    void ParsePreProcDirective(const TokenList &src, size_t &pos);
+    void ParsePragmaPack(const TokenList &src, size_t &pos);
+    void ParseAttributes(const TokenList &src, const TokenRange &range, AlignAttributes &attributes) const;
+    bool IsIncludedOnce(const TokenList &src, string &guard) const;
+    bool ParseStructUnion(const bool is_struct, const bool is_typedef, const TokenList &src, size_t &pos, VariableDeclaration &decl, bool &is_decl);
+    bool ParseEnum(const bool is_typedef, const TokenList &src, size_t &pos, VariableDeclaration &var_decl, bool &is_decl);
 
-    void ParsePreProcDirective(const string &src, size_t &pos);
-    bool ParseStructUnion(const bool is_struct, const bool is_typedef, const string &src, size_t &pos, VariableDeclaration &decl, bool &is_decl);
-    bool ParseEnum(const bool is_typedef, const string &src, size_t &pos, VariableDeclaration &var_decl, bool &is_decl);
+    size_t GetMemberSize(const VariableDeclaration &decl) const;
+    size_t GetMemberAlign(const VariableDeclaration &decl, const bool packed) const;
+    size_t GetAttributeAlign(const size_t aligned) const;
+    size_t LayoutMembers(const bool is_struct, const AlignAttributes &attributes, vector<VariableDeclaration> &members,
+                         size_t &align) const;
 
-    VariableDeclaration MakePadField(const size_t size) const;
-    size_t PadStructMembers(list<VariableDeclaration> &members);
-    size_t CalcUnionSize(const list<VariableDeclaration> &members) const;
+    /// @brief Where the members laid out so far end, @see LayoutMembers
+    typedef struct {
+        size_t  bits;       ///< end of the members, in bits
+        size_t  size;       ///< type size of the storage unit of the previous bitfields, 0 for none (Microsoft rules)
+        size_t  end;        ///< end of that storage unit, in bits
+    } BitfieldUnit;
 
-    void StoreStructUnionDef(const bool is_struct, const string &type_name, list<VariableDeclaration> &members);
+    bool PlaceBitfield(const bool is_struct, const bool packed, const size_t align, VariableDeclaration &decl,
+                       BitfieldUnit &unit) const;
+
+    void StoreStructUnionDef(const bool is_struct, const SymbolId type_name, vector<VariableDeclaration> &members,
+                             const AlignAttributes &attributes);
+    void LayoutStructUnion(const bool is_struct, const SymbolId type_name, vector<VariableDeclaration> &members,
+                           const AlignAttributes &attributes);
+    void RelayoutType(const SymbolId type_name, set<SymbolId> &done);
+    void CopyStructUnionDef(const bool is_struct, const SymbolId type_name, const SymbolId type_alias);
+    void StoreEnumDef(const SymbolId type_name, const list< pair<SymbolId, int> > &members);
+    void StoreConstant(const SymbolId name, const long value);
+    void StorePackState();
+    void RegisterType(const SymbolId type_name, const TokenTypes kind, const size_t size, const size_t align);
+
+    /// name of an interned identifier, like VariableDeclaration::data_type
+    StringView SymbolName(const SymbolId id) const { return symbols_.Name(id); }
+    bool IsAnonymousType(const SymbolId type_name) const;
 private:
     /// read in basic data such as keywords/qualifiers, and basic data type sizes
     void Initialize();
+    void RegisterBasicTypes();
 
-    void FindHeaderFiles(string path);
-    string GetFile(string& filename) const;
-
-    // pre-processing
-    string Preprocess(ifstream& ifs) const;
-    void StripComments(list<string>& lines) const;
-    void TrimLines(list<string>& lines) const;
-    void WrapLines(list<string>& lines) const;
+    void FindHeaderFiles(string path, vector<string> &found);
+    string GetFile(const string &filename);
 
     // file parsing
     void ParseLines(list<string> lines);
     void ParseToken(string& line, size_t start, size_t end);
     bool ParseIdentifier(string& token, VariableDeclaration& def) const;
 
+    /// @brief Content and tokens of a header file
+    typedef struct {
+        bool        opened;     ///< false if the file cannot be opened
+        MappedFile  source;     ///< the tokens refer to it
+        TokenList   tokens;
+    } SourceFile;
+
+    /// @brief Arguments of @method LexFileTask
+    typedef struct {
+        const vector<string>    *files;
+        vector<SourceFile *>    *sources;   ///< one for each file
+    } LexContext;
+
+    /// identity of a file - device and inode, the same through whatever path the file is named
+    typedef pair<long long, long long> FileId;
+
+    static bool GetFileId(const string &file, FileId &id);
+    void AddOnceFile(const string &file);
+
+    SourceFile *TakeSourceFile(const string &file, bool lex = true);
+    static void LexFile(const string &file, SourceFile &source, bool preprocessed = false);
+    static void LexFileTask(size_t index, void *context);
+    static void CountSourceFile(const SourceFile &source);
+    void LexFiles(const vector<string> &files);
+
+    // parsing result cache
+    bool LoadCachedResult(const string &file, const CacheKey content, const string &log);
+    CacheKey HashFile(const string &file);
+    static void AddDependency(string &deps, const string &file, const CacheKey content);
+    void LoadManifest();
+    void SaveManifest() const;
+    CacheKey CrawlOptionsHash() const;
+    void Record(const string &event);
+    bool Replay(const string &log);
+
     // utility functions
-    string GetNextToken(const string line, size_t& i) const;//TODO: , string ignore=" \t"
-    bool IsIgnorable(string token) const;
-    TokenTypes GetTokenType(const string &token) const;
-    bool IsNumericToken(const string &token, long& number) const;
-    int  GetTypeSize(const string &data_type) const;
-    void DumpTypeDefs() const;
+    bool IsIgnorable(const StringView &token) const;
+    size_t SkipParentheses(const TokenList &src, size_t pos, const size_t end) const;
+    TokenTypes GetTokenType(const StringView &token) const;
+    TokenTypes GetTokenType(const SymbolId token) const;
+    bool IsNumericToken(const StringView &token, long& number) const;
+    TokenRange JoinTokenWithLine(const size_t token_pos, const TokenRange &line) const;
+    string LineToString(const TokenList &src, const TokenRange &line) const;
+    int  GetTypeSize(const SymbolId data_type) const;
+    SymbolId MakeAnonymousTypeName();
 
 /// class members
 public:
-    static const char   EOL = '$';          ///< end of line, used to delimit the source lines within a string
-    static const size_t kAlignment_ = 4;    ///< alignment @toto: make this changeable
-    static const size_t kWordSize_ = 4;     ///< size of a machine word on a 32-bit system
-
     static const string kAnonymousTypePrefix;
-    static const string kTokenDelimiters;
-    static const string kPaddingFieldName;
     
 private:
     /// external input
     set <string> include_paths_;    
+    DirectoryCrawler crawler_;      ///< which files under the include paths are header files
+    IncludeIndex include_index_;    ///< header files under the include paths, filled by @method FindHeaderFiles
+    size_t jobs_;
+    Abi abi_;                       ///< sizes and alignments of the basic types, and the padding rules
+
+    /// all the identifiers, the maps below are keyed by their ids
+    /// it also tells what a name stands for (keyword, qualifier, type) and the size of a type
+    /// @note it's mutable as interning a name doesn't change the parsing result
+    mutable SymbolTable symbols_;
+
+    /// number of anonymous types, used to make unique names for them
+    size_t anonymous_count_;
 
-    /// basic data that're needed in parsing
-    set <string> basic_types_;
-    set <string> qualifiers_;
-    map <string, TokenTypes> keywords_;
-    
     /// header files to parse
     /// key     - filename with relative/absolute path
     /// bool    - whether the file is parsed
     map <string, bool> header_files_;
-    
-    /// Size of C data types and also user-defined struct/union types
-    /// @note All enum types have fixed size, so they're not stored
-    map <string, size_t> type_sizes_;
+
+    /// file being parsed, empty for the source given directly
+    string current_file_;
+
+    /// whether the file being parsed is preprocessed, @see ParsePreprocessedFile
+    bool preprocessed_;
+
+    /// file named by the last line marker of preprocessed source, like "Employee.h" or "<built-in>"
+    string marker_file_;
+
+    /// #pragma pack in effect, 0 for none, and the ones saved by #pragma pack(push)
+    size_t pack_;
+    vector<size_t> pack_stack_;
+
+    /// parsed header files that're included only once (@see IsIncludedOnce), they're not opened again
+    /// through another path
+    /// value   - the path it's parsed with
+    map <FileId, string> once_files_;
+    size_t once_skipped_;   ///< number of files not opened as they're included once and parsed already
+
+    /// header files that're read and tokenized in advance by @method LexFiles, but not yet parsed
+    map <string, SourceFile *> lexed_files_;
+
+    /// parsing results of the header files, @see Record
+    ParseCache cache_;
+    CacheKey state_digest_;     ///< digest of all the changes made to the type definitions so far
+    string *cache_log_;         ///< parsing result of the file being parsed, NULL when it's not to be cached
+    string *cache_deps_;        ///< files included by the file being parsed, @see LoadCachedResult
+
+    /// folders under the include paths found by the last run, @see LoadManifest
+    /// key     - include path
+    map <string, DirectoryCrawler::FolderMap> manifest_;
+    string manifest_content_;   ///< the manifest as it's loaded, it's only saved when changed
     
     /// Parsing result - extracted type definitions
     /// for below 3 maps:
@@ -123,18 +252,21 @@ private:
     /// value   - type members 
     
     /// struct definitons
-    map <string, list<VariableDeclaration> > struct_defs_;
+    map <SymbolId, vector<VariableDeclaration> > struct_defs_;
 
     /// union definitions
-    map <string, list<VariableDeclaration> > union_defs_;
+    map <SymbolId, vector<VariableDeclaration> > union_defs_;
 
     /// enum definitions
-    map <string, list< pair<string, int> > > enum_defs_;
+    map <SymbolId, list< pair<SymbolId, int> > > enum_defs_;
+
+    /// alignment attributes of the struct/union definitions that have any, to lay them out again for another ABI
+    map <SymbolId, AlignAttributes> layout_attributes_;
 
     /// constants and macros that have integer values
     /// key     - constant/macro name
     /// value   - a integer (all types of number are cast to long type for convenience)
-    map <string, long> const_defs_;
+    map <SymbolId, long> const_defs_;
     
 };
 
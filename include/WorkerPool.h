@@ -0,0 +1,31 @@
+#ifndef _WORKER_POOL_H_
+#define _WORKER_POOL_H_
+
+/// Copyright(c) 2013 Frank Fang
+///
+/// Run independent tasks on multiple threads
+///
+/// Tasks are identified by their indices [0, count) and are picked up by the workers one by one,
+/// so a few big files don't keep the other workers idle. The caller thread is one of the workers.
+/// Threads are only available with pthreads, the tasks are run one by one on the caller thread otherwise
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <stddef.h>     // size_t
+
+class WorkerPool
+{
+public:
+    /// a task, it must not touch anything shared with the other tasks without locking
+    typedef void (*Task)(size_t index, void *context);
+
+    /// run task(0) ... task(count - 1) and return when all of them are done
+    /// @param[in]  threads     maximum number of threads including the caller thread, 0 or 1 for no extra threads
+    static void Run(size_t threads, size_t count, Task task, void *context);
+
+    /// number of processors online, at least 1
+    static size_t ProcessorCount();
+};
+
+#endif  // _WORKER_POOL_H_
@@ -12,6 +12,25 @@
 #include <string>
 using namespace std;
 
+/// @brief Id of an interned identifier, @see SymbolTable
+typedef unsigned int SymbolId;
+
+/// id of the empty name, it's also returned when a name is not found
+const SymbolId kNoSymbol = 0;
+
+/// @brief Alignment attributes of a struct/union or a member
+///
+/// They come from __attribute__((packed)), __attribute__((aligned(n))) and #pragma pack(n),
+/// and they're applied as GCC does, @see TypeParser::LayoutMembers
+typedef struct {
+    bool    packed;       ///< the natural alignment is taken as 1, for a struct/union it's so for all its members
+    size_t  aligned;      ///< the alignment is at least this, 0 for none, kBiggestAlignment for "aligned" alone
+    size_t  pack;         ///< #pragma pack of a struct/union, its members are aligned to this at most; 0 for none
+} AlignAttributes;
+
+/// __attribute__((aligned)) without a value, the biggest alignment of the ABI
+const size_t kBiggestAlignment = static_cast<size_t>(-1);
+
 /// @beief Struct for variable declaration
 ///
 /// A variable declaration may contain 4 parts
@@ -22,12 +41,24 @@ using namespace std;
 ///    - is_pointer:    true
 /// @note Only one-demension array is supported here, but it's easy to extend with this awareness
 ///
+/// A bitfield member (e.g. unsigned flags : 3) has no array size nor pointer, its var_size is the size of
+/// its type; an unnamed one (e.g. int : 0) has no var_name
+///
+/// The unsigned qualifier is dropped from the data type like the others, unsigned long is a long,
+/// so it's kept aside for a struct/union member
+///
 typedef struct {
-    string  data_type;    ///< name of a data type, either basic type or user-defined type
-    string  var_name;     ///< variable name
+    SymbolId data_type;   ///< name of a data type, either basic type or user-defined type
+    SymbolId var_name;    ///< variable name
     size_t  array_size;   ///< array size: 0 for non-array
     bool    is_pointer;   ///< true when it's a pointer
     size_t  var_size;     ///< size in bytes
+    size_t  offset;       ///< offset in bytes in its struct/union, set when the struct/union is laid out
+    AlignAttributes attributes; ///< attributes of a struct/union member
+    bool    is_bitfield;  ///< true when it's a bitfield member
+    size_t  bit_width;    ///< width in bits of a bitfield
+    size_t  bit_offset;   ///< first bit of a bitfield from its offset, the lowest bit is 0; set by the layout
+    bool    is_unsigned;  ///< true when a member is declared unsigned
 } VariableDeclaration;
 
 /// @enum type for token types
@@ -44,6 +75,7 @@ enum TokenTypes {
     kAbstractType,
     kComplexType,
     kQualifier,
+    kAttributeKeyword,  ///< __attribute__ or __declspec, followed by its arguments in parentheses
 
     // user-defined tokens
     kStructName,
@@ -59,6 +91,9 @@ enum SingleToken {
     kPoundSign  = '#',
 
     kComma      = ',',
+    kColon      = ':',
+    kLeftParenthesis  = '(',
+    kRightParenthesis = ')',
     kSemicolon  = ';',
     kEqual      = '=',
     kSlash      = '/',
@@ -82,30 +82,51 @@ static inline std::string rands() {
 enum LogLevels {kError, kDebug, kInfo };
 extern LogLevels g_log_level;
 
-static void Log(enum LogLevels level, std::string msg) {
-    if (level > g_log_level) return;
+/// the most verbose level that's compiled in, e.g. build with -DLOG_MAX_LEVEL=kError to drop the others
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL kInfo
+#endif
+
+/// whether a message of the level is written, a constant false for the levels that're not compiled in
+#define LOG_ENABLED(level) ((level) <= LOG_MAX_LEVEL && (level) <= g_log_level)
+
+/// Lazy logging, the message is a stream expression which is only evaluated when the level is enabled:
+///     LOG_DEBUG("Parsing file - " << file);
+#define LOG(level, message) \
+    do { \
+        if (LOG_ENABLED(level)) { \
+            std::ostringstream log_message_; \
+            log_message_ << message; \
+            Log(level, log_message_.str()); \
+        } \
+    } while (0)
+
+#define LOG_ERROR(message)  LOG(kError, message)
+#define LOG_DEBUG(message)  LOG(kDebug, message)
+#define LOG_INFO(message)   LOG(kInfo,  message)
+
+static inline void Log(enum LogLevels level, const std::string &msg) {
+    if (!LOG_ENABLED(level)) return;
 
-    std::ostringstream os;
     switch(level) {
     case kError:
-        os << "ERROR: ";
+        std::cout << "ERROR: ";
         break;
 
     case kDebug:
-        os << "DEBUG: ";
+        std::cout << "DEBUG: ";
         break;
 
     default:
-        os << "INFO: ";
+        std::cout << "INFO: ";
     }
 
-    os << msg;
-    std::cout << os.str() << std::endl;
+    std::cout << msg << std::endl;
 }
 
-// logging shortcuts
-static void Error(std::string msg) { Log(kError, msg); }
-static void Debug(std::string msg) { Log(kDebug, msg); }
-static void Info(std::string msg)  { Log(kInfo,  msg); }
+// logging shortcuts, the message is made even if it's not written - use the macros above where it matters
+static inline void Error(const std::string &msg) { Log(kError, msg); }
+static inline void Debug(const std::string &msg) { Log(kDebug, msg); }
+static inline void Info(const std::string &msg)  { Log(kInfo,  msg); }
 
 #endif  // _UTILITY_H_
@@ -0,0 +1,159 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Description of a target ABI
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <stdlib.h>     // strtoul
+
+#include "utility.h"
+#include "Abi.h"
+
+const char *const Abi::kScalarNames[kScalarCount] = {
+    "char", "bool", "short", "int", "long", "long_long", "float", "double", "long_double", "pointer", "size_t",
+    "wchar_t", "enum"
+};
+
+/// sizes and alignments, in the order of @enum Scalar
+const Abi::Preset Abi::kPresets[] = {
+    // i386 System V: the 8-byte and bigger types are aligned to 4 only
+    { "ilp32", { {1, 1}, {1, 1}, {2, 2}, {4, 4}, {4, 4}, {8, 4}, {4, 4}, {8, 4}, {12, 4}, {4, 4}, {4, 4},
+                 {4, 4}, {4, 4} }, 1, false },
+
+    // x86-64 and AArch64 System V
+    { "lp64",  { {1, 1}, {1, 1}, {2, 2}, {4, 4}, {8, 8}, {8, 8}, {4, 4}, {8, 8}, {16, 16}, {8, 8}, {8, 8},
+                 {4, 4}, {4, 4} }, 1, false },
+
+    // 64-bit Windows: long is still 4 bytes, long double is double, and the bitfields are MSVC's
+    { "llp64", { {1, 1}, {1, 1}, {2, 2}, {4, 4}, {4, 4}, {8, 8}, {4, 4}, {8, 8}, {8, 8}, {8, 8}, {8, 8},
+                 {2, 2}, {4, 4} }, 1, true },
+};
+
+/// @brief A basic type name of the ABI
+typedef struct {
+    const char  *name;
+    Abi::Scalar scalar;
+} TypeName;
+
+/// the basic type names, the parser takes them as basic data types
+static const TypeName kTypeNames[] = {
+    { "char", Abi::kChar }, { "bool", Abi::kBool }, { "_Bool", Abi::kBool }, { "short", Abi::kShort },
+    { "int", Abi::kInt }, { "long", Abi::kLong }, { "long long", Abi::kLongLong }, { "__int64", Abi::kLongLong },
+    { "float", Abi::kFloat }, { "double", Abi::kDouble }, { "long double", Abi::kLongDouble },
+    { "size_t", Abi::kSize }, { "ssize_t", Abi::kSize }, { "ptrdiff_t", Abi::kSize },
+    { "intptr_t", Abi::kSize }, { "uintptr_t", Abi::kSize },
+    { "__SIZE_T_TYPE__", Abi::kSize }, { "__PTRDIFF_T_TYPE__", Abi::kSize },
+    { "wchar_t", Abi::kWchar }, { "__WCHAR_T_TYPE__", Abi::kWchar },
+    { "int8_t", Abi::kChar }, { "uint8_t", Abi::kChar }, { "int16_t", Abi::kShort }, { "uint16_t", Abi::kShort },
+    { "int32_t", Abi::kInt }, { "uint32_t", Abi::kInt }, { "int64_t", Abi::kLongLong },
+    { "uint64_t", Abi::kLongLong },
+};
+
+Abi::Abi(void) {
+    SetPreset(kPresets[0]);
+}
+
+void Abi::SetPreset(const Preset &preset) {
+    name_ = preset.name;
+    struct_align_ = preset.struct_align;
+    ms_bitfields_ = preset.ms_bitfields;
+
+    for (int i = 0; i < kScalarCount; ++i) {
+        scalars_[i] = preset.scalars[i];
+    }
+}
+
+// a positive number that's a power of 2 when @var power_of_2 is set
+static bool ParseSize(const string &text, bool power_of_2, size_t &value) {
+    char *end = NULL;
+    unsigned long number = strtoul(text.c_str(), &end, 10);
+
+    if (text.empty() || '\0' != *end || 0 == number || (power_of_2 && 0 != (number & (number - 1)))) return false;
+
+    value = number;
+    return true;
+}
+
+/// Set the ABI by a preset name and overrides, e.g. "ilp32,long_long=8:8,double=8:8"
+bool Abi::Parse(const string &spec) {
+    Abi abi;
+    size_t end = spec.find(',');
+    string preset = spec.substr(0, end);
+
+    size_t i = 0;
+    while (i < sizeof(kPresets) / sizeof(kPresets[0]) && preset != kPresets[i].name) ++i;
+
+    if (i == sizeof(kPresets) / sizeof(kPresets[0])) {
+        Error("Unknown ABI: " + preset + ", it must be ilp32, lp64 or llp64");
+        return false;
+    }
+
+    abi.SetPreset(kPresets[i]);
+
+    while (string::npos != end) {
+        size_t start = end + 1;
+        end = spec.find(',', start);
+
+        string item = spec.substr(start, (string::npos == end) ? string::npos : end - start);
+        size_t equal = item.find('=');
+        string key = item.substr(0, equal);
+        string value = (string::npos == equal) ? string() : item.substr(equal + 1);
+
+        if ("struct_align" == key) {
+            if (!ParseSize(value, true, abi.struct_align_)) {
+                Error("Bad struct alignment in the ABI: " + item);
+                return false;
+            }
+            continue;
+        }
+
+        if ("ms_bitfields" == key) {
+            if ("0" != value && "1" != value) {
+                Error("Bad bitfield rules in the ABI: " + item);
+                return false;
+            }
+            abi.ms_bitfields_ = ("1" == value);
+            continue;
+        }
+
+        int scalar = 0;
+        while (scalar < kScalarCount && key != kScalarNames[scalar]) ++scalar;
+
+        // <size>[:<align>], the alignment must be given when the size isn't a power of 2, e.g. long_double=12:4
+        size_t colon = value.find(':');
+        Layout layout;
+        if (kScalarCount == scalar || !ParseSize(value.substr(0, colon), false, layout.size)
+            || !ParseSize((string::npos == colon) ? value : value.substr(colon + 1), true, layout.align)) {
+            Error("Bad type size in the ABI: " + item);
+            return false;
+        }
+
+        abi.scalars_[scalar] = layout;
+    }
+
+    abi.name_ = spec;
+    *this = abi;
+    return true;
+}
+
+size_t Abi::biggest_align() const {
+    size_t align = 1;
+    for (int i = 0; i < kScalarCount; ++i) {
+        if (scalars_[i].align > align) align = scalars_[i].align;
+    }
+
+    return align;
+}
+
+size_t Abi::type_name_count() {
+    return sizeof(kTypeNames) / sizeof(kTypeNames[0]);
+}
+
+const char *Abi::type_name(size_t index) {
+    return kTypeNames[index].name;
+}
+
+Abi::Scalar Abi::type_scalar(size_t index) {
+    return kTypeNames[index].scalar;
+}
@@ -0,0 +1,281 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Character class scanning for the lexer
+///
+/// The vectorized kernels test the delimiter class with byte range comparisons:
+///     [0x09, 0x0d]    blanks
+///     [0x20, 0x2c]    ' ' ! " # $ % & ' ( ) * + ,
+///     0x2f            /
+///     [0x3a, 0x3f]    : ; < = > ?
+///     0x5b, 0x5d      [ ]
+///     [0x7b, 0x7d]    { | }
+/// which must be the same as @see Lexer::kTokenDelimiters plus blanks. Each kernel is verified against
+/// the lookup table before it's selected, so a mismatch only costs the speed, not the correctness
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <string.h>     // memset, memchr
+#include <ctype.h>      // isspace
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAS_SSE2_KERNEL
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAS_AVX2_KERNEL
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>     // _BitScanForward
+#endif
+
+#include "Lexer.h"
+#include "CharScanner.h"
+
+// index of the lowest set bit, mask must not be 0
+static inline unsigned int FirstBit(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// scalar kernels, they're also used for the tail bytes of the vectorized ones
+static bool g_delimiters[256];
+
+static const char *FindDelimiterScalar(const char *p, const char *end) {
+    while (p < end && !g_delimiters[static_cast<unsigned char>(*p)]) ++p;
+    return p;
+}
+
+// most tokens are short identifiers, so a few bytes are checked one by one before the vector loop starts
+static const int kShortTokenLength = 8;
+
+static inline bool FindDelimiterShort(const char *&p, const char *end) {
+    for (const char *stop = (end - p > kShortTokenLength) ? p + kShortTokenLength : end; p < stop; ++p) {
+        if (g_delimiters[static_cast<unsigned char>(*p)]) return true;
+    }
+    return p == end;
+}
+
+static const char *FindEitherScalar(const char *p, const char *end, char a, char b) {
+    while (p < end && a != *p && b != *p) ++p;
+    return p;
+}
+
+#ifdef HAS_SSE2_KERNEL
+// 0xff for the bytes within [lo, hi], only for ranges within [0x01, 0x7e] as the comparison is signed
+static inline __m128i InRange128(__m128i x, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(lo - 1)), _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), x));
+}
+
+static const char *FindDelimiterSse2(const char *p, const char *end) {
+    if (FindDelimiterShort(p, end)) return p;
+
+    for (; p + 16 <= end; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+
+        __m128i m = _mm_or_si128(InRange128(x, 0x09, 0x0d), InRange128(x, 0x20, 0x2c));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8(0x2f)));
+        m = _mm_or_si128(m, InRange128(x, 0x3a, 0x3f));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8(0x5b)));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8(0x5d)));
+        m = _mm_or_si128(m, InRange128(x, 0x7b, 0x7d));
+
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(m));
+        if (0 != mask) return p + FirstBit(mask);
+    }
+
+    return FindDelimiterScalar(p, end);
+}
+
+static const char *FindEitherSse2(const char *p, const char *end, char a, char b) {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+
+    for (; p + 16 <= end; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned int mask = static_cast<unsigned int>(
+            _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb))));
+
+        if (0 != mask) return p + FirstBit(mask);
+    }
+
+    return FindEitherScalar(p, end, a, b);
+}
+#endif
+
+#ifdef HAS_AVX2_KERNEL
+TARGET_AVX2 static inline __m256i InRange256(__m256i x, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8(lo - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), x));
+}
+
+TARGET_AVX2 static const char *FindDelimiterAvx2(const char *p, const char *end) {
+    if (FindDelimiterShort(p, end)) return p;
+
+    for (; p + 32 <= end; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+
+        __m256i m = _mm256_or_si256(InRange256(x, 0x09, 0x0d), InRange256(x, 0x20, 0x2c));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(0x2f)));
+        m = _mm256_or_si256(m, InRange256(x, 0x3a, 0x3f));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(0x5b)));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(0x5d)));
+        m = _mm256_or_si256(m, InRange256(x, 0x7b, 0x7d));
+
+        unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(m));
+        if (0 != mask) return p + FirstBit(mask);
+    }
+
+    return FindDelimiterScalar(p, end);
+}
+
+TARGET_AVX2 static const char *FindEitherAvx2(const char *p, const char *end, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+
+    for (; p + 32 <= end; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        unsigned int mask = static_cast<unsigned int>(
+            _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb))));
+
+        if (0 != mask) return p + FirstBit(mask);
+    }
+
+    return FindEitherScalar(p, end, a, b);
+}
+#endif
+
+/// the kernel implementations, nothing is checked here
+CharScanner::FindDelimiterFunc CharScanner::DelimiterKernel(Kernel kernel) {
+    switch (kernel) {
+#ifdef HAS_SSE2_KERNEL
+    case kSse2:
+        return FindDelimiterSse2;
+#endif
+
+#ifdef HAS_AVX2_KERNEL
+    case kAvx2:
+        return FindDelimiterAvx2;
+#endif
+
+    default:
+        return FindDelimiterScalar;
+    }
+}
+
+CharScanner::FindEitherFunc CharScanner::EitherKernel(Kernel kernel) {
+    switch (kernel) {
+#ifdef HAS_SSE2_KERNEL
+    case kSse2:
+        return FindEitherSse2;
+#endif
+
+#ifdef HAS_AVX2_KERNEL
+    case kAvx2:
+        return FindEitherAvx2;
+#endif
+
+    default:
+        return FindEitherScalar;
+    }
+}
+
+const CharScanner::Dispatch &CharScanner::Table() {
+    static const Dispatch dispatch = Initialize();
+    return dispatch;
+}
+
+/// build the lookup table, then select the fastest kernel that is supported and verified
+CharScanner::Dispatch CharScanner::Initialize() {
+    Dispatch dispatch;
+
+    for (int ch = 0; ch < 256; ++ch) {
+        g_delimiters[ch] = (0 != isspace(ch));
+    }
+
+    for (const char *p = Lexer::kTokenDelimiters; '\0' != *p; ++p) {
+        g_delimiters[static_cast<unsigned char>(*p)] = true;
+    }
+
+    memcpy(dispatch.delimiters, g_delimiters, sizeof(g_delimiters));
+
+    // from the slowest to the fastest
+    const Kernel kernels[] = { kScalar, kSse2, kAvx2 };
+
+    for (size_t i = 0; i < sizeof(kernels)/sizeof(Kernel); ++i) {
+        if (IsSupported(kernels[i]) && Verify(kernels[i], g_delimiters)) {
+            dispatch.kernel = kernels[i];
+            dispatch.find_delimiter = DelimiterKernel(kernels[i]);
+            dispatch.find_either = EitherKernel(kernels[i]);
+        }
+    }
+
+    return dispatch;
+}
+
+/// check the kernel classifies every byte value in the same way as the lookup table
+bool CharScanner::Verify(Kernel kernel, const bool *delimiters) {
+    FindDelimiterFunc find_delimiter = DelimiterKernel(kernel);
+    char buffer[64];
+
+    for (int ch = 0; ch < 256; ++ch) {
+        memset(buffer, 'a', sizeof(buffer));
+        buffer[37] = static_cast<char>(ch);
+
+        const char *expected = buffer + (delimiters[ch] ? 37 : sizeof(buffer));
+        if (expected != find_delimiter(buffer, buffer + sizeof(buffer))) return false;
+    }
+
+    return true;
+}
+
+bool CharScanner::IsSupported(Kernel kernel) {
+    switch (kernel) {
+    case kScalar:
+        return true;
+
+#ifdef HAS_SSE2_KERNEL
+    case kSse2:
+        return true;
+#endif
+
+#ifdef HAS_AVX2_KERNEL
+    case kAvx2:
+        return 0 != __builtin_cpu_supports("avx2");
+#endif
+
+    default:
+        return false;
+    }
+}
+
+const char *CharScanner::KernelName(Kernel kernel) {
+    switch (kernel) {
+    case kSse2:
+        return "sse2";
+    case kAvx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+/// @note the kernel must be supported, @see IsSupported
+const char *CharScanner::FindDelimiter(Kernel kernel, const char *p, const char *end) {
+    Table();    // make sure the lookup table is ready
+    return DelimiterKernel(kernel)(p, end);
+}
+
+/// @note the kernel must be supported, @see IsSupported
+const char *CharScanner::FindEither(Kernel kernel, const char *p, const char *end, char a, char b) {
+    return EitherKernel(kernel)(p, end, a, b);
+}
@@ -8,24 +8,66 @@
 #include <iostream>
 #include <fstream>      // ifstream
 #include <iomanip>      // setw
+#include <algorithm>    // find
+#include <string.h>     // memcpy
 
 #include "utility.h"    // tohex
 #include "DataReader.h"
 #include "TypeParser.h"
+#include "Stats.h"
 
 #define TAB_WIDTH 4
 #define FORMAT_OUTPUT(indent_depth) out_stream_ << setw(TAB_WIDTH * (indent_depth)) << ' '
 
 DataReader::DataReader(const TypeParser& parser, char* buffer, size_t size)
-    : type_parser_(parser), data_buffer_(buffer), data_size_(size), data_ptr_(NULL) {
+    : types_(own_types_), data_buffer_(buffer), data_size_(size), data_ptr_(buffer) {
+
+    string image;
+    TypeDatabase::Build(parser, image);
+    own_types_.Open(image.data(), image.length());
+
+    Initialize();
 }
 
 DataReader::DataReader(const TypeParser& parser, const string &data_file)
-    : type_parser_(parser), data_buffer_(NULL), data_size_(0), data_ptr_(NULL) {
+    : types_(own_types_), data_buffer_(NULL), data_size_(0), data_ptr_(NULL) {
+
+    string image;
+    TypeDatabase::Build(parser, image);
+    own_types_.Open(image.data(), image.length());
+
+    Initialize();
+    ReadData(data_file);
+}
 
+DataReader::DataReader(const TypeDatabase& types, char* buffer, size_t size)
+    : types_(types), data_buffer_(buffer), data_size_(size), data_ptr_(buffer) {
+
+    Initialize();
+}
+
+DataReader::DataReader(const TypeDatabase& types, const string &data_file)
+    : types_(types), data_buffer_(NULL), data_size_(0), data_ptr_(NULL) {
+
+    Initialize();
     ReadData(data_file);
 }
 
+/// the basic types that are signed, the unsigned qualifier of a member is kept aside, @see kUnsignedMember
+static const char *const kSignedTypes[] = {
+    "char", "short", "int", "long", "long long", "__int64", "ssize_t", "ptrdiff_t", "__PTRDIFF_T_TYPE__",
+    "intptr_t", "int8_t", "int16_t", "int32_t", "int64_t"
+};
+
+void DataReader::Initialize() {
+    char_type_ = types_.is_open() ? types_.FindType("char") : NULL;
+
+    for (size_t i = 0; types_.is_open() && i < sizeof(kSignedTypes) / sizeof(kSignedTypes[0]); ++i) {
+        const TypeDatabase::TypeRecord *type = types_.FindType(kSignedTypes[i]);
+        if (NULL != type) signed_types_.insert(type);
+    }
+}
+
 /// read binary data into buffer
 ///
 /// @param[in]  data_file   data file that contains binary memory dump
@@ -50,175 +92,393 @@ void DataReader::ReadData(const string &data_file) {
     // set read start address to the buffer address
     data_ptr_ = data_buffer_;
 
-	cout << "buffer addr: " << hex << &data_ptr_ << endl;
+	cout << "buffer addr: " << static_cast<void *>(&data_ptr_) << endl;
+}
+
+void DataReader::PrintTypeData(const string &type_name, bool is_union, size_t count) {
+    Stats::Scope scope(Stats::kDecoding);
+
+    // the type and its plan are looked up once for all the records
+    const TypeDatabase::TypeRecord *type = types_.is_open() ? types_.FindType(type_name) : NULL;
+    if (NULL == type) {
+        Error("Unknown struct/union: " + type_name);
+        return;
+    }
+
+    const Plan *plan = GetPlan(*type, is_union);
+    if (plan->size != data_size_) {
+        LOG_DEBUG("The buffer size is not the same as size of the type - " << type_name);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        PrintRecord(*plan);
+    }
 }
 
-void DataReader::PrintTypeData(const string &type_name, bool is_union) {
-	PrepareTypeData(type_name, 0, is_union);
+/// print the record at the read position, and move the position to the next one
+void DataReader::PrintRecord(const Plan &plan) {
+    // a single pass over the plan, the values are read at their offsets from the start of the record
+    const char *record = data_ptr_;
+    for (vector<PlanStep>::const_iterator step = plan.steps.begin(); step != plan.steps.end(); ++step) {
+        switch (step->op) {
+        case kOpenStruct:
+        case kOpenUnion:
+            PrintLabel(*step);
+
+            // if it's a fake name assigned to anonymous type, then the fake name won't be printed
+            out_stream_ << (kOpenUnion == step->op ? "union " : "struct ");
+            if (step->text.empty()) {
+                out_stream_ << "{" << endl;
+            } else {
+                out_stream_ << step->text << " {" << endl;
+            }
+            break;
+
+        case kClose:
+            FORMAT_OUTPUT(step->depth) << "}" << endl;
+            break;
+
+        case kOpenArray:
+            FORMAT_OUTPUT(step->depth) << step->name << " = [" << endl;
+            break;
+
+        case kCloseArray:
+            FORMAT_OUTPUT(step->depth) << "]" << endl;
+            break;
+
+        case kValue:
+            PrintLabel(*step);
+            PrintValue(*step, record);
+            break;
+
+        case kUnknownType:
+            PrintLabel(*step);
+            Error("Unknown struct/union: " + step->text.str());
+            break;
+
+        case kUnresolvedType:
+            PrintLabel(*step);
+            Error("Unresolved data type - " + step->text.str());
+            break;
+
+        case kRecursiveType:
+            PrintLabel(*step);
+            Error("Struct/union contains itself: " + step->text.str());
+            break;
+        }
+    }
+
+    Stats::Add(Stats::kRecordsDecoded);
+    data_ptr_ += plan.size;
 
 	/// printing
 	cout << out_stream_.str() << endl;
+	out_stream_.str("");
 }
 
-/// Print the members and their data of a struct or union in a nice fomat
-/// 
-/// This method will be recursively called for nested struct/union(s)
+/// get the plan of a type, it's compiled when the type is read for the first time
 ///
-/// @param[in]  type_name	name of a struct or union
-/// @param[in]  indent      depth of indent, for output format control
-/// @param[in]  is_union    true for union, false for struct - this is needed in @method PrintVarValue
+/// @param[in]  type	    a struct or union
+/// @param[in]  is_union    true to read it as a union
+const DataReader::Plan *DataReader::GetPlan(const TypeDatabase::TypeRecord &type, bool is_union) {
+    pair<const TypeDatabase::TypeRecord *, bool> key(&type, is_union);
+
+    map<pair<const TypeDatabase::TypeRecord *, bool>, Plan>::iterator it = plans_.find(key);
+    if (it != plans_.end()) return &it->second;
+
+    Plan &plan = plans_[key];
+    plan.values = 0;
+
+    PlanStep root = PlanStep();
+    CompileType(type, is_union, 0, root, plan);
+
+    // the records of a dump are apart by the size of the type
+    plan.size = type.size;
+
+    LOG_DEBUG("Plan of " << types_.Name(type.name) << ": " << plan.steps.size() << " steps, "
+              << plan.values << " values, " << plan.size << " bytes");
+    return &plan;
+}
+
+/// add the steps printing a struct or union and its members to a plan
+/// 
+/// This method will be recursively called for nested struct/union(s). A type nested in itself can't be laid
+/// out, it's only in a bad database, so it's compiled into an error rather than endlessly
 ///
-void DataReader::PrepareTypeData(const string &type_name, size_t indent, bool is_union) {
-	cout << type_name << " | " << (is_union ? "union" : "struct");
-
-    list<VariableDeclaration> members;
-    if (is_union && type_parser_.union_defs_.find(type_name) != type_parser_.union_defs_.end()) {
-        members = type_parser_.union_defs_[type_name];
-    } else if (type_parser_.struct_defs_.find(type_name) != type_parser_.struct_defs_.end()) {
-        members = type_parser_.struct_defs_[type_name];
+/// @param[in]  type	    a struct or union
+/// @param[in]  is_union    true for union, false for struct
+/// @param[in]  offset      where the type starts in the record
+/// @param[in]  label       how the type is introduced: depth of indent, member name or array index
+/// @param[out] plan
+void DataReader::CompileType(const TypeDatabase::TypeRecord &type, bool is_union, uint32_t offset,
+                             PlanStep label, Plan &plan) {
+    StringView type_name = types_.Name(type.name);
+
+    uint32_t first, count;
+    if (is_union && 0 != (type.flags & TypeDatabase::kUnionDefined)) {
+        first = type.union_first;
+        count = type.union_count;
+    } else if (0 != (type.flags & TypeDatabase::kStructDefined)) {
+        first = type.struct_first;
+        count = type.struct_count;
     } else {
-        Error("Unknown struct/union: " + type_name);
+        label.op = kUnknownType;
+        label.text = type_name;
+        plan.steps.push_back(label);
         return;
     }
 
-    // only need to check this when this method is called for the first time
-    if (0 == indent && type_parser_.type_sizes_[type_name] != data_size_) {
-        Debug("The buffer size is not the same as size of the type - " + type_name);
+    if (compiling_.end() != find(compiling_.begin(), compiling_.end(), &type)) {
+        label.op = kRecursiveType;
+        label.text = type_name;
+        plan.steps.push_back(label);
+        return;
     }
 
-    // if it's a fake name assigned to anonymous type, then the fake name won't be printed
-    if (0 == type_name.compare(0, sizeof(type_parser_.kAnonymousTypePrefix), type_parser_.kAnonymousTypePrefix)) {
-        out_stream_ << (is_union ? "union " : "struct ") << "{" << endl;
-    } else {
-        out_stream_ << (is_union ? "union " : "struct ") << type_name << " {" << endl;
+    label.op = is_union ? kOpenUnion : kOpenStruct;
+    label.text = (0 != (type.flags & TypeDatabase::kAnonymousType)) ? StringView() : type_name;
+    plan.steps.push_back(label);
+    compiling_.push_back(&type);
+
+    // the members are at their offsets of the layout, the padding between them is skipped,
+    // and so are the unnamed bitfields
+    for (uint32_t index = first; index < first + count; ++index) {
+        const TypeDatabase::MemberRecord &member = types_.member(index);
+        if (0 != (member.flags & TypeDatabase::kBitfieldMember) && types_.Name(member.name).empty()) continue;
+
+        CompileMember(member, offset + member.offset, label.depth + 1, plan);
     }
 
-    indent++;
-    PrintMemberData(members, indent, is_union);
-    --indent;
+    compiling_.pop_back();
 
-    FORMAT_OUTPUT(indent) << "}" << endl;
+    PlanStep close = PlanStep();
+    close.op = kClose;
+    close.depth = label.depth;
+    plan.steps.push_back(close);
 }
 
-/// Print a struct or union's fields and their data
+/// add the steps printing a struct or union member to a plan, an array is printed element by element
 ///
-/// @param[in]  members     struct/union members
-/// @param[in]  indent      depth of indent
-/// @param[in]  is_union    true for union, false for struct
-void DataReader::PrintMemberData(list<VariableDeclaration> &members, size_t indent, bool is_union) {
-    VariableDeclaration var_decl;
-
-	// remember the start address of the union data for later use as each union members has the same start address
-	char* union_addr = data_ptr_;
-
-    while(!members.empty()) {
-        var_decl = members.front();
-
-        if (!is_union && 0 == var_decl.var_name.compare(type_parser_.kPaddingFieldName)) {
-            // skip printing the padding field, but moving the data pointer is necessary
-            data_ptr_ += var_decl.var_size;
-        } else {
-			if (is_union) data_ptr_ = union_addr;
-			cout << " @ " << hex << &data_ptr_ << endl;
+/// @param[in]  member      struct/union member
+/// @param[in]  offset      where the member starts in the record
+/// @param[in]  depth       depth of indent
+/// @param[out] plan
+void DataReader::CompileMember(const TypeDatabase::MemberRecord &member, uint32_t offset, uint32_t depth,
+                               Plan &plan) {
+    PlanStep label = PlanStep();
+    label.depth = depth;
+    label.name = types_.Name(member.name);
+
+    if (0 == member.array_size) {
+        label.flags = kLabelMember;
+        CompileValue(member, member.size, offset, label, plan);
+        return;
+    }
 
-			if (var_decl.array_size != 0) {
-				// array has special format
-				FORMAT_OUTPUT(indent) << var_decl.var_name << " = [" << endl;
-				indent++;
+    // array has special format
+    label.op = kOpenArray;
+    plan.steps.push_back(label);
 
-				for (size_t i = 0; i < var_decl.array_size; i++) {
-					FORMAT_OUTPUT(indent) << "[" << i << "] = ";
-					PrintVarData(var_decl, indent, false);
-				}
+    label.flags = kLabelElement;
+    label.depth = depth + 1;
 
-				FORMAT_OUTPUT(indent) <<"]" << endl;
-				indent--;    // this line can move up one line for better indent, just to conform to example output
+    // the member size is the size of the whole array
+    uint32_t element_size = member.size / member.array_size;
+    for (uint32_t i = 0; i < member.array_size; ++i) {
+        label.index = i;
+        CompileValue(member, element_size, offset + i * element_size, label, plan);
+    }
 
-			} else {
-				// non-array
-				FORMAT_OUTPUT(indent) << var_decl.var_name << " = ";
-				PrintVarData(var_decl, indent, is_union);
-			}
-		}
+    PlanStep close = PlanStep();
+    close.op = kCloseArray;
+    close.depth = depth + 1;     // to conform to example output
+    plan.steps.push_back(close);
+}
 
-        members.pop_front();
-    }
+/// mask of the bits of a value of some bytes, the decimal is of the lowest 8 bytes at most
+static unsigned long long ByteMask(uint32_t size) {
+    return (size < 8) ? (1ULL << (8 * size)) - 1 : ~0ULL;
 }
 
-/// print a field
+/// add the steps printing a field, or an array element, to a plan
 ///
-/// @param[in]  var_decl    struct/union member declaration
-/// @param[in]  indent      depth of indent
-/// @param[in]  is_union    true for union, false for struct
-void DataReader::PrintVarData(const VariableDeclaration &var_decl, size_t indent, bool is_union) {
-    switch (type_parser_.GetTokenType(var_decl.data_type)) {
-    case kBasicDataType:
-        PrintVarValue(var_decl, indent, is_union);
-        break;
+/// @param[in]  member      struct/union member
+/// @param[in]  size        bytes of the field
+/// @param[in]  offset      where the field starts in the record
+/// @param[in]  label       how the field is introduced
+/// @param[out] plan
+void DataReader::CompileValue(const TypeDatabase::MemberRecord &member, uint32_t size, uint32_t offset,
+                              PlanStep label, Plan &plan) {
+    // a pointer is printed as an address, what it points to isn't in the record
+    if (0 != (member.flags & TypeDatabase::kPointerMember)) {
+        label.op = kValue;
+        label.offset = offset;
+        label.size = size;
+        label.mask = ByteMask(size);
+
+        plan.steps.push_back(label);
+        ++plan.values;
+        return;
+    }
+
+    // the member refers to its type record directly, no lookup is needed
+    const TypeDatabase::TypeRecord *type = (TypeDatabase::kNoType != member.type) ? &types_.type(member.type) : NULL;
 
+    switch (NULL != type ? type->kind : static_cast<uint32_t>(kUnresolvedToken)) {
     case kStructName:
-        PrepareTypeData(var_decl.data_type, indent, false);
+        CompileType(*type, false, offset, label, plan);
         break;
 
     case kUnionName:
-        PrepareTypeData(var_decl.data_type, indent, true);
+        CompileType(*type, true, offset, label, plan);
         break;
 
+    case kBasicDataType:
     case kEnumName:
-        PrintVarValue(var_decl, indent, false);
+        label.op = kValue;
+        label.offset = offset;
+        label.size = size;
+
+        if (0 != (member.flags & TypeDatabase::kBitfieldMember)) {
+            // the bits are extracted from the word at the byte of the first bit, the value is printed
+            // in the bytes it takes
+            label.flags |= kBitfieldValue;
+            label.offset = offset + member.bit_offset / 8;
+            label.shift = member.bit_offset % 8;
+            label.mask = (member.bit_width < 64) ? (1ULL << member.bit_width) - 1 : ~0ULL;
+            label.size = (member.bit_width + 7) / 8;
+        }
+
+        if (type == char_type_) {
+            label.flags |= kCharValue;
+            if (0 == (label.flags & kBitfieldValue)) label.size = 1;
+        }
+
+        if (0 == (label.flags & kBitfieldValue)) label.mask = ByteMask(label.size);
+
+        // for enum, print value like: 1, 0x01, enum Home.Anhui
+        if (0 != (type->flags & TypeDatabase::kEnumDefined)) {
+            label.flags |= kEnumValue | kSignedValue;
+            label.enum_first = type->enum_first;
+            label.enum_count = type->enum_count;
+        } else if (0 != signed_types_.count(type) && 0 == (member.flags & TypeDatabase::kUnsignedMember)) {
+            label.flags |= kSignedValue;
+        }
+
+        plan.steps.push_back(label);
+        ++plan.values;
         break;
 
     default:
-        Error("Unresolved data type - " + var_decl.data_type);
+        label.op = kUnresolvedType;
+        label.text = types_.Name(member.type_name);
+        plan.steps.push_back(label);
         break;
     }
 }
 
-/// print the value of a field
+/// print what introduces a step: the member name or the array index
+void DataReader::PrintLabel(const PlanStep &step) {
+    if (0 != (step.flags & kLabelMember)) {
+        FORMAT_OUTPUT(step.depth) << step.name << " = ";
+    } else if (0 != (step.flags & kLabelElement)) {
+        FORMAT_OUTPUT(step.depth) << "[" << step.index << "] = ";
+    }
+}
+
+/// load the little endian 8-byte word at an offset of the data, the bytes past the end are taken as 0
+static unsigned long long LoadWord(const char *data, size_t size, size_t offset) {
+    unsigned long long word = 0;
+
+    if (offset + sizeof(word) <= size) {
+        memcpy(&word, data + offset, sizeof(word));
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        return word;
+    }
+
+    for (size_t i = 0; i < sizeof(word) && offset + i < size; ++i) {
+        word |= static_cast<unsigned long long>(static_cast<unsigned char>(data[offset + i])) << (8 * i);
+    }
+
+    return word;
+}
+
+/// print the value of a field, the bytes past the end of the data are taken as 0
 ///
-/// @param[in]  var_decl    struct/union member declaration
-/// @param[in]  indent      depth of indent
-/// @param[in]  is_union    true for union, false for struct
-void DataReader::PrintVarValue(const VariableDeclaration &var_decl, size_t indent, bool is_union) {
-    int     len;
-    if (0 == var_decl.data_type.compare("char")) {
-        len = 1;
+/// A bitfield is read by a load of the word at its offset, a shift and a mask. A packed one wider than 56 bits
+/// can end past the word, its highest bits are then taken from the next word. The decimal is signed by the type
+/// of the field, @see kSignedValue, a typedef of an unsigned type isn't known as unsigned though
+///
+/// @param[in]  step        a kValue step
+/// @param[in]  record      start of the record
+void DataReader::PrintValue(const PlanStep &step, const char *record) {
+    size_t offset = static_cast<size_t>(record - data_buffer_) + step.offset;
+    if (offset + step.size > data_size_) {
+        LOG_DEBUG("bad data offset");
+    }
+
+    unsigned long long bits = LoadWord(data_buffer_, data_size_, offset);
+    if (0 != (step.flags & kBitfieldValue) && step.shift > 0) {
+        // a packed bitfield wider than 56 bits can end in the next word
+        bits >>= step.shift;
+        if (0 != (step.mask >> (64 - step.shift))) {
+            bits |= LoadWord(data_buffer_, data_size_, offset + sizeof(bits)) << (64 - step.shift);
+        }
+    }
+    bits &= step.mask;
+
+    // sign extension from the highest bit of the mask
+    unsigned long long value = bits;
+    bool negative = 0 != (step.flags & kSignedValue) && 0 != (bits & ~(step.mask >> 1));
+    if (negative) value |= ~step.mask;
+
+    out_stream_ << setw(3);
+    if (negative) {
+        out_stream_ << static_cast<long long>(value);
     } else {
-        len = var_decl.var_size;
-    }
-
-    string  data = string(data_ptr_, len);
-    string  hex_value = tohex(data);
-    int     int_value = strtol(hex_value.c_str(), NULL, 16);
-        
-    out_stream_ << setw(3) << int_value << ", " << hex_value;
-        
-    // for enum, print value like: 1, 0x01, enum Home.Anhui
-    if (!is_union && type_parser_.enum_defs_.find(var_decl.data_type) != type_parser_.enum_defs_.end()) {
-        string enumVar = "Unknown";
-        list< pair<string, int> > enums = type_parser_.enum_defs_[var_decl.data_type];
-        for (list< pair<string, int> >::const_iterator it = enums.begin(); it != enums.end(); ++it) {
-            if (int_value == it->second) {
-                enumVar = it->first;
+        out_stream_ << value;
+    }
+
+    // the hex digits from the highest byte, of the data in little endian or of the extracted bitfield,
+    // formatted by chunks of the buffer
+    const char kDigits[] = "0123456789abcdef";
+    char hex_value[32];
+
+    out_stream_ << ", 0x";
+    for (uint32_t i = 0; i < step.size; ) {
+        size_t length = 0;
+        for (; i < step.size && length < sizeof(hex_value); ++i) {
+            unsigned int byte;
+            if (0 != (step.flags & kBitfieldValue)) {
+                byte = static_cast<unsigned int>(bits >> (8 * (step.size - 1 - i))) & 0xff;
+            } else {
+                size_t pos = offset + step.size - 1 - i;
+                byte = (pos < data_size_) ? static_cast<unsigned char>(data_buffer_[pos]) : 0;
+            }
+
+            hex_value[length++] = kDigits[byte >> 4];
+            hex_value[length++] = kDigits[byte & 0x0f];
+        }
+        out_stream_.write(hex_value, length);
+    }
+
+    if (0 != (step.flags & kEnumValue)) {
+        StringView enumVar = "Unknown";
+        for (uint32_t i = step.enum_first; i < step.enum_first + step.enum_count; ++i) {
+            if (static_cast<long long>(value) == types_.enumerator(i).value) {
+                enumVar = types_.Name(types_.enumerator(i).name);
                 break;
             }
         }
         out_stream_ << ", " << enumVar;
-    } else if ("char" == var_decl.data_type && 0 != int_value) {
+    } else if (0 != (step.flags & kCharValue) && 0 != value) {
         // for char type
-        out_stream_ << ", '" << (char)('A'+(int_value - (int)'A')) << "'";
+        out_stream_ << ", '" << static_cast<char>(value) << "'";
     }
 
     out_stream_ << endl;
-
-    if (!is_union) {
-        data_ptr_ += len;
-
-        // check pointer offset
-        if ((data_ptr_ - data_buffer_) > data_size_) {
-            Debug("bad data offset");
-        }
-    }
 }
 
 DataReader::~DataReader(void)
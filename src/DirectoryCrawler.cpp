@@ -0,0 +1,324 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Find the files under a folder recursively on multiple threads
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#ifdef WIN32
+#include "dirent.h"     // opendir/readdir, @see http://www.softagalleria.net/download/dirent/
+#else
+#include <pthread.h>
+#include <sys/stat.h>	// fstatat, S_ISDIR
+#include <sys/types.h>
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <dirent.h>		// fdopendir/readdir
+#endif
+
+#include <string.h>     // strcmp
+#include <algorithm>    // sort
+
+#include "utility.h"
+#include "DirectoryCrawler.h"
+
+/// @brief State shared by the workers of one crawl
+struct DirectoryCrawler::CrawlState {
+    const DirectoryCrawler  *crawler;
+    string                  root;
+    vector<string>          pending;    ///< folders to read, relative to the root
+    size_t                  busy;       ///< number of folders being read, which can add more to @var pending
+    vector<Entry>           files;
+    size_t                  top_calls;  ///< @see Crawl
+    const FolderMap         *known;     ///< folders from a previous crawl, NULL if not given
+    FolderMap               *found;     ///< folders read or reused, NULL if not needed
+    size_t                  reused;     ///< number of folders not read again
+    size_t                  read;       ///< number of folders read
+#ifndef WIN32
+    pthread_mutex_t         lock;
+    pthread_cond_t          wake;       ///< signaled when folders are added, or when all the work is done
+#endif
+};
+
+static bool SameStamp(const DirectoryCrawler::FolderStamp &a, const DirectoryCrawler::FolderStamp &b) {
+    return a.mtime == b.mtime && a.mtime_nsec == b.mtime_nsec && a.inode == b.inode && a.size == b.size;
+}
+
+static void SetStamp(const struct stat &folderstat, DirectoryCrawler::FolderStamp &stamp) {
+    stamp.mtime = static_cast<long long>(folderstat.st_mtime);
+#ifndef WIN32
+    stamp.mtime_nsec = static_cast<long long>(folderstat.st_mtim.tv_nsec);
+#else
+    stamp.mtime_nsec = 0;
+#endif
+    stamp.inode = static_cast<long long>(folderstat.st_ino);
+    stamp.size = static_cast<long long>(folderstat.st_size);
+}
+
+static bool EntryNameLess(const DirectoryCrawler::Entry &a, const DirectoryCrawler::Entry &b) {
+    return a.name < b.name;
+}
+
+DirectoryCrawler::DirectoryCrawler(void) {
+}
+
+size_t DirectoryCrawler::Crawl(const string &folder, size_t threads, vector<Entry> &files, FolderMap *folders) const {
+    FolderMap found;
+    CrawlState state;
+    state.crawler = this;
+    state.root = folder;
+    state.pending.push_back("");
+    state.busy = 0;
+    state.top_calls = 0;
+    state.known = folders;
+    state.found = (NULL != folders) ? &found : NULL;
+    state.reused = 0;
+    state.read = 0;
+
+#ifndef WIN32
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_cond_init(&state.wake, NULL);
+
+    // the caller thread works too, so one thread less is created
+    vector<pthread_t> workers;
+    for (size_t i = 1; i < threads; ++i) {
+        pthread_t worker;
+        if (0 != pthread_create(&worker, NULL, Work, &state)) break;   // the started ones take over the folders
+
+        workers.push_back(worker);
+    }
+
+    Work(&state);
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&state.wake);
+    pthread_mutex_destroy(&state.lock);
+#else
+    Work(&state);
+#endif
+
+    // the folders are read in no particular order
+    sort(state.files.begin(), state.files.end(), EntryNameLess);
+    files.insert(files.end(), state.files.begin(), state.files.end());
+
+    if (NULL != folders) {
+        folders->swap(found);
+        LOG_INFO("Folders read: " << state.read << ", unchanged: " << state.reused << " - " << folder);
+    }
+
+    return state.top_calls;
+}
+
+void *DirectoryCrawler::Work(void *arg) {
+    CrawlState &state = *static_cast<CrawlState *>(arg);
+
+#ifndef WIN32
+    pthread_mutex_lock(&state.lock);
+#endif
+
+    for (;;) {
+#ifndef WIN32
+        while (state.pending.empty() && state.busy > 0) {
+            pthread_cond_wait(&state.wake, &state.lock);
+        }
+#endif
+        if (state.pending.empty()) break;   // no folder left, and none is being read that can add more
+
+        string relative = state.pending.back();
+        state.pending.pop_back();
+        ++state.busy;
+
+#ifndef WIN32
+        pthread_mutex_unlock(&state.lock);
+#endif
+
+        // the known folders are only read by the workers, no need to lock
+        const Folder *known = NULL;
+        if (NULL != state.known) {
+            FolderMap::const_iterator it = state.known->find(relative);
+            if (it != state.known->end()) known = &it->second;
+        }
+
+        Folder folder;
+        vector<string> errors;
+        FolderStamp stamp;
+        bool reused = (NULL != known && StatFolder(relative.empty() ? state.root : state.root + "/" + relative, stamp)
+                       && SameStamp(stamp, known->stamp));
+        if (reused) {
+            folder = *known;
+        } else {
+            folder.calls = state.crawler->ReadFolder(state.root, relative, folder, errors);
+        }
+
+        const vector<string> &folders = folder.folders;
+
+#ifndef WIN32
+        pthread_mutex_lock(&state.lock);
+#endif
+
+        --state.busy;
+        ++(reused ? state.reused : state.read);
+        if (relative.empty()) state.top_calls = folder.calls;
+        state.files.insert(state.files.end(), folder.files.begin(), folder.files.end());
+        if (NULL != state.found && folder.calls > 0) (*state.found)[relative] = folder;
+
+        // the log is written under the lock so that the lines don't mix
+        for (size_t i = 0; i < errors.size(); ++i) {
+            Error(errors[i]);
+        }
+
+        for (size_t i = 0; i < folders.size(); ++i) {
+            LOG_INFO("Searching folder: " << state.root << "/" << folders[i]);
+            state.pending.push_back(folders[i]);
+        }
+
+#ifndef WIN32
+        if (!folders.empty() || (state.pending.empty() && 0 == state.busy)) {
+            pthread_cond_broadcast(&state.wake);
+        }
+#endif
+    }
+
+#ifndef WIN32
+    pthread_mutex_unlock(&state.lock);
+#endif
+
+    return NULL;
+}
+
+bool DirectoryCrawler::StatFolder(const string &path, FolderStamp &stamp) {
+    struct stat folderstat;
+    if (0 != stat(path.c_str(), &folderstat)) return false;
+
+    SetStamp(folderstat, stamp);
+    return true;
+}
+
+/// read the entries of a folder
+/// @param[in]  relative    the folder relative to the root, empty for the root itself
+/// @param[out] content     the files found in the folder, and the sub-folders to read later
+/// @param[out] errors      messages of the entries that cannot be read
+/// @return number of readdir calls, 0 if the folder cannot be opened
+size_t DirectoryCrawler::ReadFolder(const string &root, const string &relative, Folder &content,
+                                    vector<string> &errors) const {
+    string folder = relative.empty() ? root : root + "/" + relative;
+    vector<Entry> &files = content.files;
+    vector<string> &folders = content.folders;
+    DIR *dir;
+    struct dirent *ent;
+    struct stat entrystat;
+    size_t calls = 0;
+
+#ifndef WIN32
+    // the entries whose type is unknown are stat-ed relative to the opened folder, no need to resolve the path again
+    int folder_fd = open(folder.c_str(), O_RDONLY | O_DIRECTORY);
+    dir = (folder_fd >= 0) ? fdopendir(folder_fd) : NULL;
+    if (NULL == dir && folder_fd >= 0) close(folder_fd);
+#else
+    dir = opendir(folder.c_str());
+#endif
+
+    if (NULL == dir) {
+        errors.push_back("failed to open folder: " + folder);
+        return 0;
+    }
+
+    // the stamp is taken before reading, so a change made meanwhile is seen by the next crawl
+#ifndef WIN32
+    bool stamped = (0 == fstat(folder_fd, &entrystat));
+#else
+    bool stamped = (0 == stat(folder.c_str(), &entrystat));
+#endif
+    if (stamped) {
+        SetStamp(entrystat, content.stamp);
+    } else {
+        FolderStamp unknown = { -1, -1, -1, -1 };     // never the same as a real one
+        content.stamp = unknown;
+    }
+
+    while ((ent = readdir (dir)) != NULL) {
+        ++calls;
+
+        if (0 == strcmp(ent->d_name, ".") || 0 == strcmp(ent->d_name, "..")) continue;
+
+        string name = relative.empty() ? string(ent->d_name) : relative + "/" + ent->d_name;
+        if (IsExcluded(name, ent->d_name)) continue;
+
+        bool is_folder;
+        if (DT_DIR == ent->d_type) {
+            is_folder = true;
+        } else if (DT_REG == ent->d_type) {
+            is_folder = false;
+        } else {
+            // unknown to the file system, or a link that is followed as stat does
+#ifndef WIN32
+            int ret = fstatat(dirfd(dir), ent->d_name, &entrystat, 0);
+#else
+            int ret = stat((folder + "/" + ent->d_name).c_str(), &entrystat);
+#endif
+            if (0 != ret) {
+                errors.push_back("failed to stat file/folder: " + folder + "/" + ent->d_name);
+                continue;
+            }
+
+            is_folder = S_ISDIR(entrystat.st_mode);
+        }
+
+        if (is_folder) {
+            folders.push_back(name);
+        } else if (HasExtension(ent->d_name)) {
+            Entry entry = { name, calls };
+            files.push_back(entry);
+        }
+    }
+
+    closedir (dir);
+
+    return calls + 1;   // the last call returning NULL
+}
+
+bool DirectoryCrawler::IsExcluded(const string &relative, const char *base_name) const {
+    for (vector<string>::const_iterator it = excludes_.begin(); it != excludes_.end(); ++it) {
+        if (MatchGlob(it->c_str(), relative.c_str()) || MatchGlob(it->c_str(), base_name)) return true;
+    }
+
+    return false;
+}
+
+bool DirectoryCrawler::HasExtension(const char *name) const {
+    if (extensions_.empty()) return true;
+
+    size_t length = strlen(name);
+    for (vector<string>::const_iterator it = extensions_.begin(); it != extensions_.end(); ++it) {
+        if (length >= it->length() && 0 == it->compare(name + length - it->length())) return true;
+    }
+
+    return false;
+}
+
+bool DirectoryCrawler::MatchGlob(const char *pattern, const char *name) {
+    const char *star = NULL;    // position of the last '*' met in the pattern
+    const char *resume = NULL;  // where the name is matched again if the characters after the '*' don't match
+
+    while ('\0' != *name) {
+        if ('*' == *pattern) {
+            star = pattern++;
+            resume = name;
+        } else if ('?' == *pattern || *pattern == *name) {
+            ++pattern;
+            ++name;
+        } else if (NULL != star) {
+            // let the '*' take one more character
+            pattern = star + 1;
+            name = ++resume;
+        } else {
+            return false;
+        }
+    }
+
+    while ('*' == *pattern) ++pattern;
+    return '\0' == *pattern;
+}
@@ -0,0 +1,58 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Index of the files under the include paths
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include "utility.h"
+#include "IncludeIndex.h"
+
+IncludeIndex::IncludeIndex(void) : lookups_(0), saved_syscalls_(0) {
+}
+
+void IncludeIndex::AddPath(const string &folder, const DirectoryCrawler &crawler, size_t threads,
+                           vector<string> &files, DirectoryCrawler::FolderMap *folders) {
+    vector<DirectoryCrawler::Entry> found;
+    size_t calls = crawler.Crawl(folder, threads, found, folders);
+
+    // opendir, the readdir calls and closedir
+    Path path = { folder, (calls > 0) ? calls + 2 : 1 };
+    paths_.push_back(path);
+
+    for (vector<DirectoryCrawler::Entry>::const_iterator it = found.begin(); it != found.end(); ++it) {
+        SymbolId id = names_.Intern(it->name);
+        if (id >= entries_.size()) {
+            bool nested = (string::npos != it->name.find('/'));
+            Entry entry = { paths_.size() - 1, nested ? 0 : it->position };
+            entries_.resize(id + 1, entry);
+        }
+
+        files.push_back(folder + "/" + it->name);
+    }
+}
+
+string IncludeIndex::Find(const string &name) {
+    // "./a.h" is the same as "a.h"
+    StringView relative(name);
+    while (relative.length() > 2 && relative[0] == '.' && relative[1] == '/') {
+        relative = relative.substr(2);
+    }
+
+    SymbolId id = names_.Find(relative);
+    bool found = (kNoSymbol != id && id < entries_.size());
+    size_t last = found ? entries_[id].path : paths_.size();
+
+    // what reading the include paths one by one until the name is met would cost, names of nested files are never met
+    ++lookups_;
+    for (size_t i = 0; i < paths_.size(); ++i) {
+        if (i == last && 0 != entries_[id].position) {
+            saved_syscalls_ += entries_[id].position + 2;
+            break;
+        }
+
+        saved_syscalls_ += paths_[i].scan_cost;
+    }
+
+    return found ? paths_[last].folder + "/" + relative.str() : string();
+}
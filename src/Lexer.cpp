@@ -0,0 +1,154 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Single pass lexer for C header files
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <string.h>     // memchr
+#include <ctype.h>      // isspace
+
+#include "utility.h"
+#include "defines.h"
+#include "CharScanner.h"
+#include "Lexer.h"
+
+const char *const Lexer::kTokenDelimiters = " \t#{[(<&|*>)]}?\':\",%!=/;+*$";
+
+Lexer::Lexer(const char *data, size_t size, bool preprocessed)
+    : cur_(data), end_(data + size), preprocessed_(preprocessed), line_start_(true), in_directive_(false),
+      in_quotation_(false), paren_depth_(0) {
+}
+
+/// Skip blanks, line breaks, wrapped line marks and comments before the next token
+///
+/// A line break (including those within a comment block) ends the current logical line,
+/// while a '\' at the end of line joins the next line to current one
+void Lexer::SkipBlanksAndComments() {
+    while (cur_ < end_) {
+        char ch = *cur_;
+
+        if ('\n' == ch) {
+            line_start_ = true;
+            in_directive_ = in_quotation_ = false;
+            ++cur_;
+        } else if (isspace(static_cast<unsigned char>(ch))) {
+            ++cur_;
+        } else if ('\\' == ch) {
+            // it's a wrapped line only when there're no other characters after '\'
+            const char *p = cur_ + 1;
+            while (p < end_ && '\n' != *p && isspace(static_cast<unsigned char>(*p))) ++p;
+
+            if (p < end_ && '\n' != *p) return;   // '\' is part of a token
+            if (p == end_) Error("Bad syntax: wrap line at last line");
+
+            cur_ = (p < end_) ? p + 1 : p;
+        } else if (kSlash == ch && !in_quotation_ && cur_ + 1 < end_ && kSlash == cur_[1]) {
+            // line comment, the line break is left for the next round
+            const void *p = memchr(cur_, '\n', end_ - cur_);
+            cur_ = (NULL == p) ? end_ : static_cast<const char *>(p);
+        } else if (kSlash == ch && !in_quotation_ && cur_ + 1 < end_ && kAsterisk == cur_[1]) {
+            // comment block, which can span multiple lines
+            const char *p = cur_ + 2;
+            while ((p = CharScanner::FindEither(p, end_, kAsterisk, '\n')) + 1 < end_
+                && !(kAsterisk == p[0] && kSlash == p[1])) {
+                if ('\n' == *p) {
+                    line_start_ = true;
+                    in_directive_ = in_quotation_ = false;
+                }
+                ++p;
+            }
+
+            if (p + 1 >= end_) {
+                Error("Unclosed comment block exists");
+                cur_ = end_;
+            } else {
+                cur_ = p + 2;
+            }
+        } else {
+            return;
+        }
+    }
+}
+
+/// Skip blanks and line breaks only, for preprocessed source
+void Lexer::SkipBlanks() {
+    while (cur_ < end_) {
+        char ch = *cur_;
+
+        if ('\n' == ch) {
+            line_start_ = true;
+            in_directive_ = in_quotation_ = false;
+        } else if (!isspace(static_cast<unsigned char>(ch))) {
+            return;
+        }
+
+        ++cur_;
+    }
+}
+
+bool Lexer::Next(Token &token) {
+    if (preprocessed_) {
+        SkipBlanks();
+    } else {
+        SkipBlanksAndComments();
+    }
+    if (cur_ >= end_) return false;
+
+    const char *start = cur_;
+    if (CharScanner::IsDelimiter(*cur_)) {
+        ++cur_;  // a delimiter is a token itself
+    } else {
+        cur_ = CharScanner::FindDelimiter(cur_, end_);
+    }
+
+    token.text = StringView(start, cur_ - start);
+    token.line_start = line_start_;
+
+    // decide whether the next token starts a new logical line
+    line_start_ = false;
+    switch (*start) {
+    case kPoundSign:
+        if (token.line_start) in_directive_ = true;
+        break;
+
+    case kLeftParenthesis:
+        if (!in_directive_) ++paren_depth_;
+        break;
+
+    case kRightParenthesis:
+        if (!in_directive_ && paren_depth_ > 0) --paren_depth_;
+        break;
+
+    case kComma:
+        // don't split pre-processing line, nor the arguments within parentheses
+        if (!in_directive_ && 0 == paren_depth_) line_start_ = true;
+        break;
+
+    case kSemicolon:
+        // don't split pre-processing line
+        if (!in_directive_) line_start_ = true;
+        paren_depth_ = 0;
+        break;
+
+    case kQuotation:
+        in_quotation_ = !in_quotation_;
+        break;
+
+    default:
+        break;
+    }
+
+    return true;
+}
+
+size_t Lexer::Tokenize(TokenList &tokens) {
+    size_t count = tokens.size();
+    Token token;
+
+    while (Next(token)) {
+        tokens.push_back(token);
+    }
+
+    return tokens.size() - count;
+}
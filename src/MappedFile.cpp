@@ -0,0 +1,123 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Read-only view of a whole file's content
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#ifdef WIN32
+#include <fstream>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>   // fstat, S_ISREG
+#include <sys/mman.h>   // mmap, madvise
+#include <fcntl.h>      // open
+#include <unistd.h>     // read, close
+#include <errno.h>
+#endif
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile(void) : data_(NULL), size_(0), mapped_(false) {
+}
+
+MappedFile::~MappedFile(void) {
+    Close();
+}
+
+#ifndef WIN32
+bool MappedFile::Open(const string &file) {
+    Close();
+
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat filestat;
+    if (0 != fstat(fd, &filestat)) {
+        close(fd);
+        return false;
+    }
+
+    // only regular files with content can be mapped, pipes and files like those under /proc report no size
+    if (S_ISREG(filestat.st_mode) && filestat.st_size > 0) {
+        void *addr = mmap(NULL, static_cast<size_t>(filestat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED != addr) {
+            // the lexer walks the content once from the beginning to the end
+            madvise(addr, static_cast<size_t>(filestat.st_size), MADV_SEQUENTIAL);
+
+            data_ = static_cast<const char *>(addr);
+            size_ = static_cast<size_t>(filestat.st_size);
+            mapped_ = true;
+
+            close(fd);  // the mapping stays valid after the file is closed
+            return true;
+        }
+    }
+
+    bool ret = ReadAll(fd);
+    close(fd);
+
+    return ret;
+}
+
+/// read the file content into buffer until end of file
+bool MappedFile::ReadAll(int fd) {
+    char chunk[64 * 1024];
+    ssize_t count;
+
+    buffer_.clear();
+    while (0 != (count = read(fd, chunk, sizeof(chunk)))) {
+        if (count < 0) {
+            if (EINTR == errno) continue;
+
+            buffer_.clear();
+            return false;
+        }
+
+        buffer_.append(chunk, static_cast<size_t>(count));
+    }
+
+    data_ = buffer_.data();
+    size_ = buffer_.length();
+    return true;
+}
+
+void MappedFile::Close() {
+    if (mapped_) {
+        munmap(const_cast<char *>(data_), size_);
+    }
+
+    buffer_.clear();
+    data_ = NULL;
+    size_ = 0;
+    mapped_ = false;
+}
+#else
+bool MappedFile::Open(const string &file) {
+    Close();
+
+    ifstream ifs(file.c_str(), ios::in | ios::binary);
+    if (ifs.fail()) return false;
+
+    ifs.seekg(0, ifs.end);
+    buffer_.resize(static_cast<size_t>(ifs.tellg()));
+
+    ifs.seekg(0, ifs.beg);
+    ifs.read(&buffer_[0], buffer_.length());
+
+    data_ = buffer_.data();
+    size_ = buffer_.length();
+    return true;
+}
+
+bool MappedFile::ReadAll(int fd) {
+    return false;
+}
+
+void MappedFile::Close() {
+    buffer_.clear();
+    data_ = NULL;
+    size_ = 0;
+    mapped_ = false;
+}
+#endif
@@ -0,0 +1,226 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// On-disk cache of parsing results
+///
+/// Layout of the cache folder:
+///     index               one line for each hashed file: <content hash> <mtime> <mtime_nsec> <size> <file name>
+///     <key>.log           parsing result of a file, @see TypeParser::Replay for its format
+///     manifest            header files found under the include paths, @see TypeParser::LoadManifest
+/// Files are written into a temporary file and then renamed, so that a reader never sees a partial one
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <sys/types.h>
+#include <sys/stat.h>   // stat, mkdir
+#include <stdio.h>      // rename, remove, sprintf
+#include <stdlib.h>     // strtoull
+
+#ifdef WIN32
+#include <process.h>    // _getpid
+#define getpid _getpid
+#else
+#include <unistd.h>     // getpid
+#endif
+#include <fstream>
+#include <sstream>
+
+#ifdef WIN32
+#include <direct.h>     // _mkdir
+#endif
+
+#include "utility.h"
+#include "ParseCache.h"
+
+/// first line of the index, the cache is dropped when it doesn't match
+static const char *const kIndexVersion = "parse-cache 2";
+
+const CacheKey ParseCache::kHashSeed;
+
+ParseCache::ParseCache(void) : dirty_(false) {
+    index_stamp_ = FileStamp();
+}
+
+ParseCache::~ParseCache(void) {
+    Save();
+}
+
+bool ParseCache::Open(const string &folder) {
+    struct stat folderstat;
+
+    if (0 != stat(folder.c_str(), &folderstat)) {
+#ifdef WIN32
+        int ret = _mkdir(folder.c_str());
+#else
+        int ret = mkdir(folder.c_str(), 0755);
+#endif
+        if (0 != ret) {
+            Error("Failed to create cache folder - " + folder);
+            return false;
+        }
+    } else if (0 == (folderstat.st_mode & S_IFDIR)) {
+        Error("Cache path is not a folder - " + folder);
+        return false;
+    }
+
+    folder_ = folder;
+    index_.clear();
+    dirty_ = false;
+
+    // the entries modified since the index was written are racy, @see IsRacy
+    string index = folder_ + "/index";
+    index_stamp_ = FileStamp();
+    Stat(index, index_stamp_);
+
+    ifstream is(index.c_str());
+    string line;
+    if (!getline(is, line) || line != kIndexVersion) return true;  // no index yet, or of another version
+
+    while (getline(is, line)) {
+        istringstream fields(line);
+        FileStamp stamp = FileStamp();
+        string hash, file;
+
+        if (fields >> hash >> stamp.mtime >> stamp.mtime_nsec >> stamp.size && fields.get() == ' '
+            && getline(fields, file)) {
+            stamp.hash = strtoull(hash.c_str(), NULL, 16);
+            index_[file] = stamp;
+        }
+    }
+
+    LOG_DEBUG("Loaded cache index - " << folder_);
+    return true;
+}
+
+bool ParseCache::Stat(const string &file, FileStamp &stamp) {
+    struct stat filestat;
+    if (0 != stat(file.c_str(), &filestat)) return false;
+
+    stamp.mtime = static_cast<long long>(filestat.st_mtime);
+#ifndef WIN32
+    stamp.mtime_nsec = static_cast<long long>(filestat.st_mtim.tv_nsec);
+#else
+    stamp.mtime_nsec = 0;
+#endif
+    stamp.size = static_cast<long long>(filestat.st_size);
+    return true;
+}
+
+/// whether a file was modified in the same tick as the index was written, or later: it can be changed again
+/// in that tick without a change of its stamp, so its hash in the index can't be trusted
+bool ParseCache::IsRacy(const FileStamp &stamp) const {
+    if (stamp.hashed) return false;
+
+    return stamp.mtime > index_stamp_.mtime
+        || (stamp.mtime == index_stamp_.mtime && stamp.mtime_nsec >= index_stamp_.mtime_nsec);
+}
+
+bool ParseCache::FindContentHash(const string &file, CacheKey &hash) const {
+    map<string, FileStamp>::const_iterator it = index_.find(file);
+    FileStamp stamp;
+
+    if (it == index_.end() || IsRacy(it->second) || !Stat(file, stamp)) return false;
+    if (stamp.mtime != it->second.mtime || stamp.mtime_nsec != it->second.mtime_nsec
+        || stamp.size != it->second.size) {
+        return false;
+    }
+
+    hash = it->second.hash;
+    return true;
+}
+
+void ParseCache::SetContentHash(const string &file, CacheKey hash) {
+    FileStamp stamp;
+    if (!Stat(file, stamp)) return;
+
+    stamp.hash = hash;
+    stamp.hashed = true;
+    index_[file] = stamp;
+    dirty_ = true;
+}
+
+string ParseCache::NameOf(CacheKey key) {
+    char name[32];
+    sprintf(name, "%016llx.log", key);
+
+    return name;
+}
+
+bool ParseCache::Load(CacheKey key, string &log) const {
+    return LoadFile(NameOf(key), log);
+}
+
+bool ParseCache::Store(CacheKey key, const string &log) const {
+    return StoreFile(NameOf(key), log);
+}
+
+bool ParseCache::LoadFile(const string &name, string &content) const {
+    if (!is_open()) return false;
+
+    ifstream is((folder_ + "/" + name).c_str(), ios::in | ios::binary);
+    if (is.fail()) return false;
+
+    ostringstream os;
+    os << is.rdbuf();
+    content = os.str();
+
+    return true;
+}
+
+bool ParseCache::StoreFile(const string &name, const string &content) const {
+    if (!is_open()) return false;
+
+    return WriteFile(folder_ + "/" + name, content);
+}
+
+void ParseCache::Save() {
+    if (!is_open() || !dirty_) return;
+
+    ostringstream os;
+    os << kIndexVersion << '\n';
+
+    for (map<string, FileStamp>::const_iterator it = index_.begin(); it != index_.end(); ++it) {
+        char hash[32];
+        sprintf(hash, "%016llx", it->second.hash);
+
+        os << hash << ' ' << it->second.mtime << ' ' << it->second.mtime_nsec << ' ' << it->second.size << ' '
+           << it->first << '\n';
+    }
+
+    if (WriteFile(folder_ + "/index", os.str())) {
+        dirty_ = false;
+    }
+}
+
+bool ParseCache::WriteFile(const string &path, const string &content) {
+    // the pid keeps the processes sharing the cache from writing the same temporary file
+    ostringstream temp;
+    temp << path << ".tmp" << getpid();
+
+    ofstream os(temp.str().c_str(), ios::out | ios::binary | ios::trunc);
+    os.write(content.data(), content.length());
+    os.close();
+
+#ifdef WIN32
+    remove(path.c_str());   // rename doesn't replace an existing file on Windows
+#endif
+
+    if (os.fail() || 0 != rename(temp.str().c_str(), path.c_str())) {
+        remove(temp.str().c_str());
+        Error("Failed to write cache file - " + path);
+        return false;
+    }
+
+    return true;
+}
+
+CacheKey ParseCache::Hash(const char *data, size_t size, CacheKey seed) {
+    CacheKey hash = seed;
+
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
@@ -0,0 +1,369 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Timers and counters of the processing phases
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#ifdef WIN32
+#include <windows.h>    // QueryPerformanceCounter, InterlockedIncrement
+#include <malloc.h>     // _aligned_malloc
+#else
+#include <time.h>       // clock_gettime
+#include <unistd.h>     // read, syscall
+#endif
+
+#ifdef __linux__
+#include <string.h>     // memset
+#include <sys/syscall.h>    // __NR_perf_event_open
+#include <linux/perf_event.h>
+#endif
+
+#include <stdlib.h>     // malloc, free, posix_memalign
+#include <new>          // bad_alloc, new_handler, nothrow_t
+#include <iomanip>
+
+#include "Stats.h"
+
+static const char *const kPhaseNames[] = {
+    "discovery", "tokenizing", "cache", "preprocessing", "parsing", "layout", "decoding"
+};
+
+static const char *const kCounterNames[] = {
+    "files", "bytes", "tokens", "directives", "declarations", "lookups", "allocations", "records_decoded"
+};
+
+static const char *const kEventNames[] = {
+    "cycles", "instructions", "cache_misses", "branch_misses", "page_faults"
+};
+
+Stats::Phase        Stats::current_ = Stats::kPhaseCount;
+double              Stats::start_ = 0;
+double              Stats::seconds_[Stats::kPhaseCount];
+unsigned long long  Stats::entries_[Stats::kPhaseCount];
+unsigned long long  Stats::counters_[Stats::kCounterCount];
+
+bool                Stats::events_enabled_ = false;
+int                 Stats::event_fds_[Stats::kEventCount] = { -1, -1, -1, -1, -1 };
+unsigned long long  Stats::event_start_[Stats::kEventCount];
+unsigned long long  Stats::events_[Stats::kPhaseCount][Stats::kEventCount];
+
+/// allocations are counted on all the threads, so it's kept apart from @var counters_ and changed atomically
+#ifdef WIN32
+static volatile LONG g_allocations = 0;
+#else
+static volatile unsigned long long g_allocations = 0;
+#endif
+
+Stats::Scope::Scope(Phase phase) : previous_(current_) {
+    ++entries_[phase];
+    Switch(phase);
+}
+
+Stats::Scope::~Scope() {
+    Switch(previous_);
+}
+
+/// charge the time and events since the last switch to the current phase, and make another one current
+void Stats::Switch(Phase phase) {
+    double now = Now();
+    if (kPhaseCount != current_) seconds_[current_] += now - start_;
+
+    if (events_enabled_) {
+        unsigned long long values[kEventCount];
+        ReadEvents(values);
+
+        for (int i = 0; i < kEventCount; ++i) {
+            if (kPhaseCount != current_) events_[current_][i] += values[i] - event_start_[i];
+            event_start_[i] = values[i];
+        }
+    }
+
+    current_ = phase;
+    start_ = now;
+}
+
+bool Stats::EnableEvents() {
+#ifdef __linux__
+    if (events_enabled_) return true;
+
+    const struct {
+        unsigned int        type;
+        unsigned long long  config;
+    } kEvents[kEventCount] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    };
+
+    // the events are opened one by one rather than as a group, so that the available ones are counted
+    // even if some are not supported; the enabled and running times scale the counts if they're multiplexed
+    for (int i = 0; i < kEventCount; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = kEvents[i].type;
+        attr.config = kEvents[i].config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;    // allowed with perf_event_paranoid up to 2
+        attr.exclude_hv = 1;
+
+        event_fds_[i] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        if (event_fds_[i] >= 0) events_enabled_ = true;
+    }
+
+    if (events_enabled_) ReadEvents(event_start_);
+#endif
+
+    return events_enabled_;
+}
+
+/// read the values of the events counted so far, 0 for the events not counted
+void Stats::ReadEvents(unsigned long long values[kEventCount]) {
+    for (int i = 0; i < kEventCount; ++i) {
+        values[i] = 0;
+
+#ifdef __linux__
+        unsigned long long data[3];     // value, time enabled, time running
+        if (event_fds_[i] < 0 || sizeof(data) != read(event_fds_[i], data, sizeof(data))) continue;
+
+        values[i] = (data[2] > 0 && data[2] < data[1])
+            ? static_cast<unsigned long long>(static_cast<double>(data[0]) * data[1] / data[2]) : data[0];
+#endif
+    }
+}
+
+void Stats::Reset() {
+    for (int i = 0; i < kPhaseCount; ++i) {
+        seconds_[i] = 0;
+        entries_[i] = 0;
+    }
+
+    for (int i = 0; i < kCounterCount; ++i) {
+        counters_[i] = 0;
+    }
+
+    for (int i = 0; i < kPhaseCount; ++i) {
+        for (int j = 0; j < kEventCount; ++j) {
+            events_[i][j] = 0;
+        }
+    }
+
+    g_allocations = 0;
+}
+
+void Stats::AddAllocation() {
+#ifdef WIN32
+    InterlockedIncrement(&g_allocations);
+#else
+    __sync_fetch_and_add(&g_allocations, 1);
+#endif
+}
+
+bool Stats::has_counter(Counter counter) {
+#ifdef STATS_HOT_COUNTERS
+    (void)counter;
+    return true;
+#else
+    return kLookups != counter && kAllocations != counter;
+#endif
+}
+
+unsigned long long Stats::counter(Counter counter) {
+    return (kAllocations == counter) ? static_cast<unsigned long long>(g_allocations) : counters_[counter];
+}
+
+double Stats::Now() {
+#ifdef WIN32
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return static_cast<double>(count.QuadPart) / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+void Stats::Print(ostream &os, bool json) {
+    double total = 0;
+    for (int i = 0; i < kPhaseCount; ++i) {
+        total += seconds_[i];
+    }
+
+    // the stream may be left in another base, e.g. hex
+    ios_base::fmtflags flags = os.flags();
+    streamsize precision = os.precision();
+    os << dec << fixed << setprecision(3);
+
+    if (json) {
+        os << "{\"phases\": {";
+        for (int i = 0; i < kPhaseCount; ++i) {
+            os << (i > 0 ? ", " : "") << "\"" << kPhaseNames[i] << "\": {\"entries\": " << entries_[i]
+               << ", \"ms\": " << seconds_[i] * 1000;
+
+            // the events not available are left out
+            if (events_enabled_) {
+                const char *separator = "";
+                os << ", \"events\": {";
+                for (int j = 0; j < kEventCount; ++j) {
+                    if (!has_event(static_cast<Event>(j))) continue;
+
+                    os << separator << "\"" << kEventNames[j] << "\": " << events_[i][j];
+                    separator = ", ";
+                }
+                os << "}";
+            }
+
+            os << "}";
+        }
+
+        // the counters not available are left out as well
+        const char *separator = "";
+        os << "}, \"total_ms\": " << total * 1000 << ", \"counters\": {";
+        for (int i = 0; i < kCounterCount; ++i) {
+            if (!has_counter(static_cast<Counter>(i))) continue;
+
+            os << separator << "\"" << kCounterNames[i] << "\": " << counter(static_cast<Counter>(i));
+            separator = ", ";
+        }
+        os << "}}" << endl;
+    } else {
+        os << left << setw(16) << "phase" << right << setw(12) << "entries" << setw(14) << "time (ms)";
+        for (int j = 0; events_enabled_ && j < kEventCount; ++j) {
+            os << setw(16) << kEventNames[j];
+        }
+        os << endl;
+
+        for (int i = 0; i < kPhaseCount; ++i) {
+            os << left << setw(16) << kPhaseNames[i] << right << setw(12) << entries_[i]
+               << setw(14) << seconds_[i] * 1000;
+            for (int j = 0; events_enabled_ && j < kEventCount; ++j) {
+                if (has_event(static_cast<Event>(j))) {
+                    os << setw(16) << events_[i][j];
+                } else {
+                    os << setw(16) << "n/a";
+                }
+            }
+            os << endl;
+        }
+        os << left << setw(16) << "total" << right << setw(12) << "" << setw(14) << total * 1000 << endl << endl;
+
+        os << left << setw(16) << "counter" << right << setw(26) << "value" << endl;
+        for (int i = 0; i < kCounterCount; ++i) {
+            os << left << setw(16) << kCounterNames[i] << right << setw(26);
+            if (has_counter(static_cast<Counter>(i))) {
+                os << counter(static_cast<Counter>(i)) << endl;
+            } else {
+                os << "n/a" << endl;
+            }
+        }
+    }
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+#ifdef STATS_HOT_COUNTERS
+// count the allocations of the whole program, every form of operator new is replaced so that none is missed
+// dynamic exception specifications are gone since C++17, the replacements must match the declarations of <new>
+#if __cplusplus >= 201103L
+#define THROW_BAD_ALLOC
+#define THROW_NOTHING   noexcept
+#else
+#define THROW_BAD_ALLOC throw(std::bad_alloc)
+#define THROW_NOTHING   throw()
+#endif
+
+// allocate as the library does: on failure the new handler is called and it's tried again,
+// bad_alloc is thrown when there's no handler
+// @param align     0 for the default alignment of malloc
+static void *Allocate(size_t size, size_t align) {
+    Stats::AddAllocation();
+    if (0 == size) size = 1;
+
+    for (;;) {
+        void *p = NULL;
+        if (0 == align) {
+            p = malloc(size);
+        } else {
+#ifdef WIN32
+            p = _aligned_malloc(size, align);
+#else
+            if (0 != posix_memalign(&p, (align > sizeof(void *)) ? align : sizeof(void *), size)) p = NULL;
+#endif
+        }
+        if (NULL != p) return p;
+
+        // std::get_new_handler is C++11
+        std::new_handler handler = std::set_new_handler(NULL);
+        std::set_new_handler(handler);
+        if (NULL == handler) throw std::bad_alloc();
+
+        handler();
+    }
+}
+
+static void *AllocateNothrow(size_t size, size_t align) {
+    try {
+        return Allocate(size, align);
+    } catch (const std::bad_alloc &) {
+        return NULL;
+    }
+}
+
+static void Release(void *p, bool aligned) {
+#ifdef WIN32
+    if (aligned) {
+        _aligned_free(p);
+        return;
+    }
+#endif
+    (void)aligned;
+    free(p);
+}
+
+void *operator new(size_t size) THROW_BAD_ALLOC { return Allocate(size, 0); }
+void *operator new[](size_t size) THROW_BAD_ALLOC { return Allocate(size, 0); }
+void *operator new(size_t size, const std::nothrow_t &) THROW_NOTHING { return AllocateNothrow(size, 0); }
+void *operator new[](size_t size, const std::nothrow_t &) THROW_NOTHING { return AllocateNothrow(size, 0); }
+
+void operator delete(void *p) THROW_NOTHING { Release(p, false); }
+void operator delete[](void *p) THROW_NOTHING { Release(p, false); }
+void operator delete(void *p, const std::nothrow_t &) THROW_NOTHING { Release(p, false); }
+void operator delete[](void *p, const std::nothrow_t &) THROW_NOTHING { Release(p, false); }
+
+#if __cplusplus >= 201402L
+// sized deallocation, which would go to the library's operator delete otherwise
+void operator delete(void *p, size_t) THROW_NOTHING { Release(p, false); }
+void operator delete[](void *p, size_t) THROW_NOTHING { Release(p, false); }
+#endif
+
+#ifdef __cpp_aligned_new
+// the types aligned beyond the default alignment of new
+void *operator new(size_t size, std::align_val_t align) {
+    return Allocate(size, static_cast<size_t>(align));
+}
+void *operator new[](size_t size, std::align_val_t align) {
+    return Allocate(size, static_cast<size_t>(align));
+}
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) THROW_NOTHING {
+    return AllocateNothrow(size, static_cast<size_t>(align));
+}
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) THROW_NOTHING {
+    return AllocateNothrow(size, static_cast<size_t>(align));
+}
+
+void operator delete(void *p, std::align_val_t) THROW_NOTHING { Release(p, true); }
+void operator delete[](void *p, std::align_val_t) THROW_NOTHING { Release(p, true); }
+void operator delete(void *p, size_t, std::align_val_t) THROW_NOTHING { Release(p, true); }
+void operator delete[](void *p, size_t, std::align_val_t) THROW_NOTHING { Release(p, true); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) THROW_NOTHING { Release(p, true); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) THROW_NOTHING { Release(p, true); }
+#endif
+
+#endif  // STATS_HOT_COUNTERS
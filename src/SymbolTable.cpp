@@ -0,0 +1,101 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Interned identifiers
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include "SymbolTable.h"
+#include "Stats.h"
+
+static const SymbolInfo kUnknownSymbol = { kUnresolvedToken, false, 0, 0, NULL, NULL, NULL };
+
+/// initial number of hash slots, must be a power of 2
+static const size_t kInitialSlots = 1024;
+
+SymbolTable::SymbolTable(void) : slots_(kInitialSlots, kNoSymbol) {
+    // the empty name takes id kNoSymbol so that it's never a valid result of a lookup
+    Entry empty = { 0, 0, 0 };
+    entries_.push_back(empty);
+    infos_.push_back(kUnknownSymbol);
+}
+
+/// FNV-1a hash
+unsigned int SymbolTable::Hash(const StringView &name) {
+    unsigned int hash = 2166136261u;
+
+    for (size_t i = 0; i < name.length(); ++i) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/// find the slot of the name, or the empty slot where it should be placed
+size_t SymbolTable::Probe(const StringView &name, unsigned int hash) const {
+    size_t mask = slots_.size() - 1;
+    size_t slot = hash & mask;
+
+    while (kNoSymbol != slots_[slot]) {
+        const Entry &entry = entries_[slots_[slot]];
+        if (entry.hash == hash && name == StringView(pool_.data() + entry.offset, entry.length)) break;
+
+        slot = (slot + 1) & mask;   // linear probing
+    }
+
+    return slot;
+}
+
+SymbolId SymbolTable::Intern(const StringView &name) {
+    if (name.empty()) return kNoSymbol;
+
+    Stats::AddHot(Stats::kLookups);
+
+    unsigned int hash = Hash(name);
+    size_t slot = Probe(name, hash);
+    if (kNoSymbol != slots_[slot]) return slots_[slot];
+
+    Entry entry = { pool_.length(), name.length(), hash };
+    pool_.append(name.data(), name.length());
+
+    SymbolId id = static_cast<SymbolId>(entries_.size());
+    entries_.push_back(entry);
+    infos_.push_back(kUnknownSymbol);
+    slots_[slot] = id;
+
+    // keep the load factor under 1/2 so that the probing sequences stay short
+    if (2 * entries_.size() > slots_.size()) Grow();
+
+    return id;
+}
+
+SymbolId SymbolTable::Find(const StringView &name) const {
+    if (name.empty()) return kNoSymbol;
+
+    Stats::AddHot(Stats::kLookups);
+
+    return slots_[Probe(name, Hash(name))];
+}
+
+StringView SymbolTable::Name(SymbolId id) const {
+    if (id >= entries_.size()) return StringView();
+
+    const Entry &entry = entries_[id];
+    return StringView(pool_.data() + entry.offset, entry.length);
+}
+
+/// double the hash slots and re-insert all the ids
+void SymbolTable::Grow() {
+    vector<SymbolId> slots(slots_.size() * 2, kNoSymbol);
+    size_t mask = slots.size() - 1;
+
+    for (SymbolId id = 1; id < entries_.size(); ++id) {
+        size_t slot = entries_[id].hash & mask;
+        while (kNoSymbol != slots[slot]) slot = (slot + 1) & mask;
+
+        slots[slot] = id;
+    }
+
+    slots_.swap(slots);
+}
@@ -0,0 +1,442 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Flat binary database of the parsed type definitions
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#include <string.h>     // memcpy, memcmp, memset
+#include <stdio.h>      // sprintf
+#include <fstream>
+#include <vector>
+#include <list>
+#include <map>
+
+#include "utility.h"
+#include "TypeParser.h"
+#include "TypeDatabase.h"
+#include "Stats.h"
+
+static const char kMagic[8] = { 'C', 'T', 'Y', 'P', 'E', 'D', 'B', '\0' };
+
+const uint32_t TypeDatabase::kVersion;
+const uint32_t TypeDatabase::kNoType;
+const uint32_t TypeDatabase::kAnonymousType;
+const uint32_t TypeDatabase::kStructDefined;
+const uint32_t TypeDatabase::kUnionDefined;
+const uint32_t TypeDatabase::kEnumDefined;
+const uint32_t TypeDatabase::kPointerMember;
+const uint32_t TypeDatabase::kBitfieldMember;
+const uint32_t TypeDatabase::kUnsignedMember;
+
+TypeDatabase::TypeDatabase(void)
+    : data_(NULL), size_(0), header_(NULL), types_(NULL), members_(NULL),
+      enumerators_(NULL), constants_(NULL), slots_(NULL), strings_(NULL) {
+}
+
+/// FNV-1a hash of a type name
+uint32_t TypeDatabase::Hash(const StringView &name) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < name.length(); ++i) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/// Fingerprint of the record layouts and the byte order
+///
+/// A database written by a build with different records, or on a machine of another byte order, is rejected
+uint32_t TypeDatabase::LayoutFingerprint() {
+    const uint32_t byte_order = 0x01020304;
+    char layout[128];
+
+    sprintf(layout, "%u %u %u %u %u %u %u %u", static_cast<unsigned int>(sizeof(Header)),
+        static_cast<unsigned int>(sizeof(TypeRecord)), static_cast<unsigned int>(sizeof(MemberRecord)),
+        static_cast<unsigned int>(sizeof(EnumeratorRecord)), static_cast<unsigned int>(sizeof(ConstantRecord)),
+        static_cast<unsigned int>(sizeof(NameRef)), static_cast<unsigned int>(*reinterpret_cast<const char *>(&byte_order)),
+        static_cast<unsigned int>(kNoType));
+
+    return Hash(layout);
+}
+
+// append the raw bytes of records to the image
+template <typename T>
+static void AppendRecords(string &image, const vector<T> &records) {
+    if (!records.empty()) {
+        image.append(reinterpret_cast<const char *>(&records[0]), records.size() * sizeof(T));
+    }
+}
+
+// offset and length of a name in the string area, the name is appended when it's not yet stored
+static TypeDatabase::NameRef StoreName(SymbolId id, const TypeParser &parser, vector<TypeDatabase::NameRef> &names,
+                                       string &strings) {
+    static const uint32_t kNotStored = 0xffffffff;
+    TypeDatabase::NameRef &name = names[id];
+
+    if (kNotStored == name.offset) {
+        StringView text = parser.SymbolName(id);
+        name.offset = static_cast<uint32_t>(strings.length());
+        name.length = static_cast<uint32_t>(text.length());
+        strings.append(text.data(), text.length());
+    }
+
+    return name;
+}
+
+/// Make the database image of the parsing result
+///
+/// The types are the basic types and all the struct/union/enum types, in the order they're first seen
+void TypeDatabase::Build(const TypeParser &parser, string &image) {
+    const SymbolTable &symbols = parser.symbols_;
+
+    vector<TypeRecord> types;
+    vector<MemberRecord> members;
+    vector<EnumeratorRecord> enumerators;
+    vector<ConstantRecord> constants;
+    string strings;
+
+    // each name is stored once, and only when it's used
+    NameRef not_stored = { 0xffffffff, 0 };
+    vector<NameRef> names(symbols.size(), not_stored);
+
+    // index of the type record of each symbol
+    vector<uint32_t> type_index(symbols.size(), kNoType);
+
+    for (SymbolId id = 1; id < symbols.size(); ++id) {
+        const SymbolInfo &info = symbols.Info(id);
+        if (info.has_size) {
+            type_index[id] = static_cast<uint32_t>(types.size());
+            types.push_back(TypeRecord());
+        }
+    }
+
+    for (SymbolId id = 1; id < symbols.size(); ++id) {
+        if (kNoType == type_index[id]) continue;
+
+        const SymbolInfo &info = symbols.Info(id);
+        TypeRecord &type = types[type_index[id]];
+
+        memset(&type, 0, sizeof(type));
+        type.name = StoreName(id, parser, names, strings);
+        type.kind = info.kind;
+        type.flags = (parser.IsAnonymousType(id) ? kAnonymousType : 0)
+                   | ((NULL != info.struct_def) ? kStructDefined : 0)
+                   | ((NULL != info.union_def) ? kUnionDefined : 0)
+                   | ((NULL != info.enum_def) ? kEnumDefined : 0);
+        type.size = static_cast<uint32_t>(info.size);
+        type.align = static_cast<uint32_t>(info.align);
+
+        const vector<VariableDeclaration> *defs[] = { info.struct_def, info.union_def };
+        uint32_t *firsts[] = { &type.struct_first, &type.union_first };
+        uint32_t *counts[] = { &type.struct_count, &type.union_count };
+
+        for (size_t i = 0; i < 2; ++i) {
+            *firsts[i] = static_cast<uint32_t>(members.size());
+            if (NULL == defs[i]) continue;
+
+            for (vector<VariableDeclaration>::const_iterator it = defs[i]->begin(); it != defs[i]->end(); ++it) {
+                MemberRecord member;
+                member.name = StoreName(it->var_name, parser, names, strings);
+                member.type_name = StoreName(it->data_type, parser, names, strings);
+                member.type = (it->data_type < type_index.size()) ? type_index[it->data_type] : kNoType;
+                member.flags = (it->is_pointer ? kPointerMember : 0) | (it->is_bitfield ? kBitfieldMember : 0)
+                    | (it->is_unsigned ? kUnsignedMember : 0);
+                member.array_size = static_cast<uint32_t>(it->array_size);
+                member.size = static_cast<uint32_t>(it->var_size);
+                member.offset = static_cast<uint32_t>(it->offset);
+                member.bit_offset = static_cast<uint32_t>(it->bit_offset);
+                member.bit_width = static_cast<uint32_t>(it->bit_width);
+                members.push_back(member);
+            }
+
+            *counts[i] = static_cast<uint32_t>(members.size()) - *firsts[i];
+        }
+
+        type.enum_first = static_cast<uint32_t>(enumerators.size());
+        if (NULL != info.enum_def) {
+            for (list< pair<SymbolId, int> >::const_iterator it = info.enum_def->begin();
+                it != info.enum_def->end(); ++it) {
+                EnumeratorRecord enumerator;
+                enumerator.name = StoreName(it->first, parser, names, strings);
+                enumerator.value = it->second;
+                enumerators.push_back(enumerator);
+            }
+        }
+        type.enum_count = static_cast<uint32_t>(enumerators.size()) - type.enum_first;
+    }
+
+    for (map<SymbolId, long>::const_iterator it = parser.const_defs_.begin(); it != parser.const_defs_.end(); ++it) {
+        ConstantRecord constant;
+        long long value = it->second;
+
+        constant.name = StoreName(it->first, parser, names, strings);
+        constant.value_low = static_cast<uint32_t>(value);
+        constant.value_high = static_cast<uint32_t>(static_cast<unsigned long long>(value) >> 32);
+        constants.push_back(constant);
+    }
+
+    // keep the load factor under 1/2, so there's always an empty slot to stop the probing
+    uint32_t hash_slots = 16;
+    while (hash_slots < 2 * types.size()) hash_slots *= 2;
+
+    vector<uint32_t> slots(hash_slots, 0);
+    for (uint32_t i = 0; i < types.size(); ++i) {
+        uint32_t slot = Hash(StringView(strings.data() + types[i].name.offset, types[i].name.length)) & (hash_slots - 1);
+        while (0 != slots[slot]) slot = (slot + 1) & (hash_slots - 1);
+
+        slots[slot] = i + 1;
+    }
+
+    Header header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.fingerprint = LayoutFingerprint();
+    header.type_count = static_cast<uint32_t>(types.size());
+    header.member_count = static_cast<uint32_t>(members.size());
+    header.enumerator_count = static_cast<uint32_t>(enumerators.size());
+    header.constant_count = static_cast<uint32_t>(constants.size());
+    header.hash_slots = hash_slots;
+    header.string_size = static_cast<uint32_t>(strings.length());
+    header.file_size = static_cast<uint32_t>(sizeof(Header) + types.size() * sizeof(TypeRecord)
+        + members.size() * sizeof(MemberRecord) + enumerators.size() * sizeof(EnumeratorRecord)
+        + constants.size() * sizeof(ConstantRecord) + slots.size() * sizeof(uint32_t) + strings.length());
+
+    image.clear();
+    image.reserve(header.file_size);
+    image.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    AppendRecords(image, types);
+    AppendRecords(image, members);
+    AppendRecords(image, enumerators);
+    AppendRecords(image, constants);
+    AppendRecords(image, slots);
+    image.append(strings);
+}
+
+bool TypeDatabase::Write(const TypeParser &parser, const string &file) {
+    string image;
+    Build(parser, image);
+
+    ofstream os(file.c_str(), ios::out | ios::binary | ios::trunc);
+    os.write(image.data(), image.length());
+    os.close();
+
+    if (os.fail()) {
+        Error("Failed to write type database - " + file);
+        return false;
+    }
+
+    return true;
+}
+
+bool TypeDatabase::Open(const string &file) {
+    header_ = NULL;
+    image_.clear();
+
+    if (!file_.Open(file)) {
+        Error("Failed to open type database - " + file);
+        return false;
+    }
+
+    data_ = file_.data();
+    size_ = file_.size();
+
+    if (!Validate()) {
+        Error("Bad type database - " + file);
+        file_.Close();
+        return false;
+    }
+
+    return true;
+}
+
+bool TypeDatabase::Open(const char *data, size_t size) {
+    header_ = NULL;
+    file_.Close();
+
+    image_.assign(data, size);
+    data_ = image_.data();
+    size_ = image_.length();
+
+    if (!Validate()) {
+        Error("Bad type database image");
+        image_.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool TypeDatabase::IsValidName(const NameRef &name) const {
+    return name.offset <= header_->string_size && name.length <= header_->string_size - name.offset;
+}
+
+/// whether a member lies within the struct/union owning it, and its elements are not bigger than its size,
+/// so that decoding a record never reads past it nor allocates for more elements than its bytes
+bool TypeDatabase::IsValidMember(const TypeRecord &owner, const MemberRecord &member) const {
+    unsigned long long end = static_cast<unsigned long long>(member.offset) + member.size;
+    if (0 != (member.flags & kBitfieldMember)) {
+        // only the bytes holding its bits, the window of its type size can go past a packed struct
+        end = (static_cast<unsigned long long>(member.offset) * 8 + member.bit_offset + member.bit_width + 7) / 8;
+    }
+
+    if (end > owner.size || member.array_size > member.size) return false;
+    if (kNoType == member.type || 0 != (member.flags & (kPointerMember | kBitfieldMember))) return true;
+
+    unsigned long long elements = (member.array_size > 0) ? member.array_size : 1;
+    return static_cast<unsigned long long>(types_[member.type].size) * elements <= member.size;
+}
+
+/// whether no struct/union contains itself through its members, pointers aside, which would make decoding
+/// it endless. It's a depth-first search with an explicit stack, as a bad file can nest the types deeply
+bool TypeDatabase::IsAcyclic() const {
+    enum { kNotVisited, kVisiting, kVisited };
+    vector<unsigned char> states(header_->type_count, kNotVisited);
+    vector< pair<uint32_t, uint32_t> > path;   // types being visited and the next member of each to follow
+
+    for (uint32_t root = 0; root < header_->type_count; ++root) {
+        if (kNotVisited != states[root]) continue;
+
+        states[root] = kVisiting;
+        path.push_back(make_pair(root, 0u));
+
+        while (!path.empty()) {
+            const TypeRecord &type = types_[path.back().first];
+            uint32_t next = path.back().second++;
+
+            if (next >= type.struct_count + type.union_count) {
+                states[path.back().first] = kVisited;
+                path.pop_back();
+                continue;
+            }
+
+            const MemberRecord &member = members_[(next < type.struct_count) ? type.struct_first + next
+                                                                             : type.union_first + next - type.struct_count];
+            if (kNoType == member.type || 0 != (member.flags & kPointerMember)) continue;
+
+            if (kVisiting == states[member.type]) return false;
+            if (kNotVisited == states[member.type]) {
+                states[member.type] = kVisiting;
+                path.push_back(make_pair(member.type, 0u));
+            }
+        }
+    }
+
+    return true;
+}
+
+/// Check the header, the bounds of all the sections, and all the indices and names in the records
+///
+/// @return true if the content is a valid database, and the section pointers are set
+bool TypeDatabase::Validate() {
+    if (size_ < sizeof(Header) || 0 != reinterpret_cast<size_t>(data_) % sizeof(uint32_t)) return false;
+
+    const Header *header = reinterpret_cast<const Header *>(data_);
+    if (0 != memcmp(header->magic, kMagic, sizeof(kMagic)) || kVersion != header->version
+        || LayoutFingerprint() != header->fingerprint || size_ != header->file_size) {
+        return false;
+    }
+
+    // the hash table must have an empty slot, or a lookup would never stop
+    if (0 == header->hash_slots || 0 != (header->hash_slots & (header->hash_slots - 1))
+        || header->hash_slots <= header->type_count) {
+        return false;
+    }
+
+    // the sections must be exactly one after another, the sizes are added up in 64 bits so that nothing overflows
+    unsigned long long offset = sizeof(Header);
+    const unsigned long long sections[] = {
+        static_cast<unsigned long long>(header->type_count) * sizeof(TypeRecord),
+        static_cast<unsigned long long>(header->member_count) * sizeof(MemberRecord),
+        static_cast<unsigned long long>(header->enumerator_count) * sizeof(EnumeratorRecord),
+        static_cast<unsigned long long>(header->constant_count) * sizeof(ConstantRecord),
+        static_cast<unsigned long long>(header->hash_slots) * sizeof(uint32_t),
+        header->string_size,
+    };
+    const char *starts[sizeof(sections)/sizeof(sections[0])];
+
+    for (size_t i = 0; i < sizeof(sections)/sizeof(sections[0]); ++i) {
+        starts[i] = data_ + offset;
+        offset += sections[i];
+    }
+
+    if (offset != size_) return false;
+
+    header_ = header;
+    types_ = reinterpret_cast<const TypeRecord *>(starts[0]);
+    members_ = reinterpret_cast<const MemberRecord *>(starts[1]);
+    enumerators_ = reinterpret_cast<const EnumeratorRecord *>(starts[2]);
+    constants_ = reinterpret_cast<const ConstantRecord *>(starts[3]);
+    slots_ = reinterpret_cast<const uint32_t *>(starts[4]);
+    strings_ = starts[5];
+
+    bool valid = true;
+    for (uint32_t i = 0; valid && i < header_->type_count; ++i) {
+        const TypeRecord &type = types_[i];
+        valid = IsValidName(type.name)
+            && type.struct_first <= header_->member_count && type.struct_count <= header_->member_count - type.struct_first
+            && type.union_first <= header_->member_count && type.union_count <= header_->member_count - type.union_first
+            && type.enum_first <= header_->enumerator_count
+            && type.enum_count <= header_->enumerator_count - type.enum_first;
+    }
+
+    for (uint32_t i = 0; valid && i < header_->member_count; ++i) {
+        valid = IsValidName(members_[i].name) && IsValidName(members_[i].type_name) && (kNoType == members_[i].type || members_[i].type < header_->type_count)
+            && members_[i].bit_offset < 8 * sizeof(uint64_t) && members_[i].bit_width <= 8 * sizeof(uint64_t);
+    }
+
+    for (uint32_t i = 0; valid && i < header_->type_count; ++i) {
+        const TypeRecord &type = types_[i];
+        for (uint32_t m = type.struct_first; valid && m < type.struct_first + type.struct_count; ++m) {
+            valid = IsValidMember(type, members_[m]);
+        }
+        for (uint32_t m = type.union_first; valid && m < type.union_first + type.union_count; ++m) {
+            valid = IsValidMember(type, members_[m]);
+        }
+    }
+
+    valid = valid && IsAcyclic();
+
+    for (uint32_t i = 0; valid && i < header_->enumerator_count; ++i) {
+        valid = IsValidName(enumerators_[i].name);
+    }
+
+    for (uint32_t i = 0; valid && i < header_->constant_count; ++i) {
+        valid = IsValidName(constants_[i].name);
+    }
+
+    for (uint32_t i = 0; valid && i < header_->hash_slots; ++i) {
+        valid = (slots_[i] <= header_->type_count);
+    }
+
+    if (!valid) header_ = NULL;
+    return valid;
+}
+
+const TypeDatabase::TypeRecord *TypeDatabase::FindType(const StringView &name) const {
+    uint32_t mask = header_->hash_slots - 1;
+
+    Stats::AddHot(Stats::kLookups);
+
+    for (uint32_t slot = Hash(name) & mask; 0 != slots_[slot]; slot = (slot + 1) & mask) {
+        const TypeRecord &type = types_[slots_[slot] - 1];
+        if (name == Name(type.name)) return &type;
+    }
+
+    return NULL;
+}
+
+bool TypeDatabase::FindConstant(const StringView &name, long &value) const {
+    for (uint32_t i = 0; i < header_->constant_count; ++i) {
+        if (name == Name(constants_[i].name)) {
+            unsigned long long bits = (static_cast<unsigned long long>(constants_[i].value_high) << 32)
+                                    | constants_[i].value_low;
+            value = static_cast<long>(static_cast<long long>(bits));
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -5,74 +5,136 @@
 /// @author Frank Fang (fanghm@gmail.com)
 /// @date   2013/07/06
 
-#ifdef WIN32
-#include "dirent.h"     // opendir/readdir, @see http://www.softagalleria.net/download/dirent/
-#else
-#include <sys/stat.h>	// S_ISDIR
-#include <sys/types.h>	// opendir/readdir
-#include <dirent.h>		// DIR
 #include <math.h>		// ceil
-#endif
-
-#include <fstream>
+#include <stdio.h>      // sprintf
+#include <stdlib.h>     // strtoull
+#include <ctype.h>      // isdigit
+#include <sys/stat.h>   // stat
 #include <iostream>
+#include <algorithm>    // sort
 #include <assert.h>
 
 #include "utility.h"
+#include "MappedFile.h"
+#include "WorkerPool.h"
+#include "Stats.h"
 #include "TypeParser.h"
 
 
-/// underline ('_') shouldn't be included as it can be part of an identifier
-const string TypeParser::kTokenDelimiters = " \t#{[(<&|*>)]}?\':\",%!=/;+*$";
-
 /// prefix that is used to make a fake identifier for anonymous struct/union/enum type
 const string TypeParser::kAnonymousTypePrefix = "_ANONYMOUS_";
 
-/// name of padding field into a struct/union, for the purpose of alignment
-const string TypeParser::kPaddingFieldName = "_padding_field_";
+/// format of the parsing results in the cache, it's the seed of their keys so that the results of another
+/// format are never loaded, @see Replay
+static const char kResultFormat[] = "result 5";
 
 
 TypeParser::~TypeParser(void) {
+    for (map<string, SourceFile *>::iterator it = lexed_files_.begin(); it != lexed_files_.end(); ++it) {
+        delete it->second;
+    }
 }
 
-TypeParser::TypeParser(void) {
+TypeParser::TypeParser(void)
+    : jobs_(1), anonymous_count_(0), preprocessed_(false), pack_(0), once_skipped_(0),
+      state_digest_(ParseCache::Hash(kResultFormat)), cache_log_(NULL), cache_deps_(NULL) {
+    crawler_.SetExtensions(vector<string>(1, ".h"));
     Initialize();
 }
 
 void TypeParser::Initialize() {
-    // basic data types
-    const string data_types[] = {
-        "char", "short", "int", "size_t", "ssize_t", "long", "float", "double", "void", "bool", "__int64", 
-        "__WCHAR_T_TYPE__", "__SIZE_T_TYPE__", "__PTRDIFF_T_TYPE__"
-    };
-        
-    basic_types_ = set<string>(data_types, data_types + sizeof(data_types)/sizeof(string));
+    RegisterBasicTypes();
 
     // qualifiers to ignore in parsing
-    const string qualifiers[] = {
+    const char *qualifiers[] = {
         "static", "const", "signed", "unsigned", "far", "extern", 
-        "volatile", "auto", "register", "inline", "__attribute__"
+        "volatile", "auto", "register", "inline"
     };
 
-    qualifiers_ = set<string>(qualifiers, qualifiers + sizeof(qualifiers)/sizeof(string));
+    for (size_t i = 0; i < sizeof(qualifiers)/sizeof(qualifiers[0]); ++i) {
+        symbols_.Info(symbols_.Intern(qualifiers[i])).kind = kQualifier;
+    }
+
+    // attributes, skipped in parsing with their arguments, @see ParseAttributes
+    const char *attributes[] = { "__attribute__", "__attribute", "__declspec" };
+
+    for (size_t i = 0; i < sizeof(attributes)/sizeof(attributes[0]); ++i) {
+        symbols_.Info(symbols_.Intern(attributes[i])).kind = kAttributeKeyword;
+    }
 
     // keywords that we care
-    keywords_["struct"]  = kStructKeyword;
-    keywords_["union"]   = kUnionKeyword;
-    keywords_["enum"]    = kEnumKeyword;
-    keywords_["typedef"] = kTypedefKeyword;
+    symbols_.Info(symbols_.Intern("struct")).kind  = kStructKeyword;
+    symbols_.Info(symbols_.Intern("union")).kind   = kUnionKeyword;
+    symbols_.Info(symbols_.Intern("enum")).kind    = kEnumKeyword;
+    symbols_.Info(symbols_.Intern("typedef")).kind = kTypedefKeyword;
+}
 
-    // sizes of basic data types on 32-bit system, in bytes
-    for (set <string>::const_iterator it = basic_types_.begin(); it != basic_types_.end(); ++it) {
-        type_sizes_[*it] = kWordSize_; 
+/// Register the basic data types with their sizes of the ABI, @see Abi
+void TypeParser::RegisterBasicTypes() {
+    for (size_t i = 0; i < Abi::type_name_count(); ++i) {
+        const Abi::Layout &layout = abi_.scalar(Abi::type_scalar(i));
+        RegisterType(symbols_.Intern(Abi::type_name(i)), kBasicDataType, layout.size, layout.align);
+    }
+
+    RegisterType(symbols_.Intern("void"), kBasicDataType, 0, 1);
+}
+
+/// Change the target ABI
+///
+/// The basic types get the sizes of the ABI, then the enums, structs and unions parsed so far are laid out
+/// again from their declarations, so the header files are not read again
+void TypeParser::SetAbi(const Abi &abi) {
+    Stats::Scope scope(Stats::kLayout);
+
+    abi_ = abi;
+    RegisterBasicTypes();
+
+    for (map<SymbolId, list< pair<SymbolId, int> > >::const_iterator it = enum_defs_.begin(); it != enum_defs_.end();
+        ++it) {
+        RegisterType(it->first, kEnumName, abi_.scalar(Abi::kEnum).size, abi_.scalar(Abi::kEnum).align);
+    }
+
+    // a type is laid out after the types of its members
+    set<SymbolId> done;
+    for (map<SymbolId, vector<VariableDeclaration> >::const_iterator it = struct_defs_.begin(); it != struct_defs_.end();
+        ++it) {
+        RelayoutType(it->first, done);
+    }
+
+    for (map<SymbolId, vector<VariableDeclaration> >::const_iterator it = union_defs_.begin(); it != union_defs_.end();
+        ++it) {
+        RelayoutType(it->first, done);
+    }
+
+    if (!done.empty()) {
+        LOG_INFO("Types laid out for ABI " << abi_.name() << ": " << done.size() << " structs/unions");
+    }
+}
+
+/// Lay out a struct or union of the current ABI again, and the types of its members before it
+///
+/// @param[in]      type_name   name of a struct/union, or both
+/// @param[in,out]  done        types laid out already
+void TypeParser::RelayoutType(const SymbolId type_name, set<SymbolId> &done) {
+    if (!done.insert(type_name).second) return;
+
+    vector<VariableDeclaration> *defs[] = { NULL, NULL };
+    if (struct_defs_.count(type_name) > 0) defs[0] = &struct_defs_[type_name];
+    if (union_defs_.count(type_name) > 0) defs[1] = &union_defs_[type_name];
+
+    for (size_t i = 0; i < 2; ++i) {
+        if (NULL == defs[i]) continue;
+
+        vector<VariableDeclaration> &members = *defs[i];
+        for (vector<VariableDeclaration>::iterator it = members.begin(); it != members.end(); ++it) {
+            if (!it->is_pointer) RelayoutType(it->data_type, done);
+            it->var_size = GetMemberSize(*it);
+        }
+
+        map<SymbolId, AlignAttributes>::const_iterator attributes = layout_attributes_.find(type_name);
+        LayoutStructUnion(0 == i, type_name, members,
+                          (attributes != layout_attributes_.end()) ? attributes->second : AlignAttributes());
     }
-    
-    type_sizes_["void"]      = 0;
-    type_sizes_["char"]      = 1;
-    type_sizes_["short"]     = 2;
-    type_sizes_["bool"]      = 1;
-    type_sizes_["__WCHAR_T_TYPE__"] = 1;
-    
 }
 
 /// Set header file includsion path
@@ -84,6 +146,12 @@ void TypeParser::SetIncludePaths(const set <string> paths) {
 
 /// Parse all header files under including paths
 ///
+/// The files are parsed path by path, and by name within a path. With more than one job (@see SetJobs),
+/// all the files are read and tokenized on multiple threads first, but the parsing is still done one
+/// file by one in the same order: a declaration needs the sizes of the types defined before it, in the
+/// same file, in an included file (parsed right at the #include line), or in an earlier file.
+/// So the result is always the same as parsing with a single thread
+///
 /// @note current folder will be added by default
 ///
 void TypeParser::ParseFiles() {
@@ -91,12 +159,113 @@ void TypeParser::ParseFiles() {
     // since include_paths_ is a set, it won't be added duplicately
     //include_paths_.insert(".");
     
-    for (set <string>::const_iterator it = include_paths_.begin(); it != include_paths_.end(); ++it) {
-        FindHeaderFiles(*it);
+    vector<string> files;
+    {
+        Stats::Scope scope(Stats::kDiscovery);
 
-        for (map<string, bool>::const_iterator it = header_files_.begin(); it != header_files_.end(); ++it) {
-            ParseFile(it->first);
+        // the folders that are not changed since the last run are not read again
+        LoadManifest();
+
+        for (set <string>::const_iterator it = include_paths_.begin(); it != include_paths_.end(); ++it) {
+            vector<string> found;
+            FindHeaderFiles(*it, found);
+
+            sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        }
+
+        SaveManifest();
+    }
+
+    if (jobs_ > 1) {
+        // the files that are not changed are likely to be found in the cache, no need to read them
+        vector<string> changed;
+        CacheKey hash;
+        for (vector<string>::const_iterator it = files.begin(); it != files.end(); ++it) {
+            if (!cache_.FindContentHash(*it, hash)) changed.push_back(*it);
         }
+
+        LexFiles(changed);
+    }
+
+    for (vector<string>::const_iterator it = files.begin(); it != files.end(); ++it) {
+        ParseFile(*it);
+    }
+
+    cache_.Save();
+
+    LOG_INFO("Include lookups: " << include_index_.lookups()
+             << ", directory reading calls saved: " << include_index_.saved_syscalls()
+             << ", files included once not opened again: " << once_skipped_);
+}
+
+/// Get the content and tokens of a header file, the caller takes the ownership
+///
+/// The file is mapped and tokenized in place, unless it's done in advance by LexFiles
+/// @param[in]  lex     whether to read the file when it's not done in advance, else NULL is returned
+TypeParser::SourceFile *TypeParser::TakeSourceFile(const string &file, bool lex) {
+    SourceFile *source = NULL;
+
+    map<string, SourceFile *>::iterator lexed = lexed_files_.find(file);
+    if (lexed != lexed_files_.end()) {
+        source = lexed->second;
+        lexed_files_.erase(lexed);
+    } else if (lex) {
+        Stats::Scope scope(Stats::kTokenizing);
+
+        source = new SourceFile;
+        LexFile(file, *source, preprocessed_);
+        CountSourceFile(*source);
+    }
+
+    return source;
+}
+
+/// Read and tokenize a header file
+void TypeParser::LexFile(const string &file, SourceFile &source, bool preprocessed) {
+    source.opened = source.source.Open(file);
+    if (!source.opened) return;
+
+    source.tokens.reserve(source.source.size() / 4);
+
+    Lexer lexer(source.source.data(), source.source.size(), preprocessed);
+    lexer.Tokenize(source.tokens);
+}
+
+/// Add a file read to the counters, it's only called on the parsing thread
+void TypeParser::CountSourceFile(const SourceFile &source) {
+    if (!source.opened) return;
+
+    Stats::Add(Stats::kFiles);
+    Stats::Add(Stats::kBytes, source.source.size());
+    Stats::Add(Stats::kTokens, source.tokens.size());
+}
+
+void TypeParser::LexFileTask(size_t index, void *context) {
+    LexContext *lex = static_cast<LexContext *>(context);
+    LexFile(lex->files->at(index), *lex->sources->at(index));
+}
+
+/// Read and tokenize header files on multiple threads, @see SetJobs
+///
+/// The results are kept in @var lexed_files_ until the files are parsed by @method ParseFile
+void TypeParser::LexFiles(const vector<string> &files) {
+    vector<SourceFile *> sources;
+    for (size_t i = 0; i < files.size(); ++i) {
+        sources.push_back(new SourceFile);
+    }
+
+    Stats::Scope scope(Stats::kTokenizing);
+
+    LexContext context = { &files, &sources };
+    WorkerPool::Run(jobs_, files.size(), LexFileTask, &context);
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        CountSourceFile(*sources[i]);
+
+        SourceFile *&lexed = lexed_files_[files[i]];
+        delete lexed;   // in case the same file is lexed twice
+        lexed = sources[i];
     }
 }
 
@@ -109,348 +278,383 @@ void TypeParser::ParseFiles() {
 void TypeParser::ParseFile(const string &file) {
     // parse a file only when it's not yet parsed
     if (header_files_.find(file) != header_files_.end() && header_files_[file]) {
-        Info("File is already processed: " + file);
+        LOG_INFO("File is already processed: " << file);
         return;
     }
 
-    ifstream ifs(file.c_str(), ios::in);
-    if (ifs.fail()) {
+    // a file included only once is not opened again when it's named by another path, e.g. "./a.h" and "a.h"
+    FileId id;
+    if (!once_files_.empty() && GetFileId(file, id)) {
+        map<FileId, string>::const_iterator once = once_files_.find(id);
+        if (once != once_files_.end()) {
+            LOG_INFO("File is included once and already processed as " << once->second << ": " << file);
+            header_files_[file] = true;
+            ++once_skipped_;
+            return;
+        }
+    }
+
+    SourceFile *source = NULL;
+    CacheKey key = 0;
+    CacheKey content = 0;
+    string log;
+
+    if (cache_.is_open()) {
+        Stats::Scope scope(Stats::kCache);
+
+        // the result of parsing a file depends on both its content and the definitions made before it,
+        // and on whether it's preprocessed
+        state_digest_ = ParseCache::Hash(preprocessed_ ? "-E " + file : file, state_digest_);
+
+        if (!cache_.FindContentHash(file, content)) {
+            source = TakeSourceFile(file);
+            content = source->opened ? ParseCache::Hash(source->source.data(), source->source.size()) : 0;
+            if (source->opened) cache_.SetContentHash(file, content);
+        }
+
+        key = ParseCache::Hash(reinterpret_cast<const char *>(&content), sizeof(content), state_digest_);
+
+        if (cache_.Load(key, log) && LoadCachedResult(file, content, log)) {
+            delete source;
+            delete TakeSourceFile(file, false);  // release it if read in advance
+            return;
+        }
+    }
+
+    if (NULL == source) source = TakeSourceFile(file);
+    if (!source->opened) {
         Error("Failed to open file - " + file);
+        delete source;
+
+        if (NULL != cache_deps_) AddDependency(*cache_deps_, file, 0);  // it matters when the file is added later
         return;
     }
 
     // flag to true before parsing the file so that it won't be parsed duplicately
     header_files_[file] = true;
-    Debug("Parsing file - " + file);
+    LOG_DEBUG("Parsing file - " << file);
 
-    ParseSource(Preprocess(ifs));
+    // record the changes made by this file and the files it includes, an included file records its own
+    string *outer_log = cache_log_;
+    string *outer_deps = cache_deps_;
+    string deps;
+    log.clear();
 
-    DumpTypeDefs();// TODO: remove it
-}
+    cache_log_ = cache_.is_open() ? &log : NULL;
+    cache_deps_ = cache_.is_open() ? &deps : NULL;
 
-/*
- * Recursively find all the header files under specified folder
- * and store them into header_files_ 
- * 
- * Folder name can end with either "\\" or "/", or without any
- *
- * Assumption: header files end with ".h"
- */
-void TypeParser::FindHeaderFiles(string folder) {
-    DIR *dir;
-    struct dirent *ent;
-    struct stat entrystat;
-
-    if ((dir = opendir (folder.c_str())) != NULL) {
-        while ((ent = readdir (dir)) != NULL) {
-            string name(ent->d_name);
-            if (name.compare(".") == 0 || name.compare("..") == 0) continue;
-
-            name = folder + "/" + name;
-            if (0 == stat(name.c_str(), &entrystat)) {
-                if (S_ISDIR(entrystat.st_mode)) {
-                    Info("Searching folder: " + name);
-                    FindHeaderFiles(name);
-                } else {
-                    if (name.length() > 2 && name.substr(name.length()-2, 2).compare(".h") == 0) {
-                        header_files_[name] = false;    // "false" means not yet parsed
-                        Debug("Found header file: " + name);
-                    } else {
-                        Info("Ignoring file: " + name);
-                    }
-                }
-            } else {
-                Error("failed to stat file/folder: " + name);                
-            }
-        }
-
-        closedir (dir);
-    } else {
-        Error("failed to open folder: " + folder);
+    string guard;
+    if (IsIncludedOnce(source->tokens, guard)) {
+        LOG_DEBUG("File is included once by " << guard << " - " << file);
+        AddOnceFile(file);
     }
-}
 
-// search a file from the include paths
-// when found, return full path of the file and also update the input argument
-// else return empty string - it's up to the caller to check the return value
-string TypeParser::GetFile(string& filename) const {
-    DIR *dir;
-    struct dirent *ent;
-    string path_name;
-
-    for (set <string>::const_iterator it = include_paths_.begin(); it != include_paths_.end(); ++it) {
-        string folder = *it;
-        if ((dir = opendir (folder.c_str())) == NULL) continue;
-
-        while ((ent = readdir (dir)) != NULL) {
-            string name(ent->d_name);
-            if (name.compare(filename) == 0) {
-                path_name = folder + "/" + filename;
-                break;
-            }
-        }
+    // the names are copied into the symbol table, so the file content is released after parsing
+    string outer_file = current_file_;
+    current_file_ = file;
 
-        closedir (dir);
-        if (!path_name.empty()) break;
-    }
+    ParseTokens(source->tokens);
+    delete source;
 
-    return (filename = path_name);
-}
+    current_file_ = outer_file;
 
-string TypeParser::Preprocess(ifstream &ifs) const {
-    string line;
-    list<string> lines;
+    cache_log_ = outer_log;
+    cache_deps_ = outer_deps;
 
-    while(ifs.good()) {
-        getline(ifs, line);
-    
-        if (!trim(line).empty()) {
-            lines.push_back(line);
+    if (cache_.is_open()) {
+        cache_.Store(key, deps + log);
+
+        if (NULL != cache_deps_) {
+            cache_deps_->append(deps);
+            AddDependency(*cache_deps_, file, content);
         }
     }
-
-    StripComments(lines);
-    WrapLines(lines);
- 
-    return MergeAllLines(lines);
 }
 
-/// Strip all comments from code lines
+/// Parse a preprocessed translation unit, e.g. made by "gcc -E -dD"
+///
+/// No file is included as the preprocessor has done it, so it's one linear pass over the file. The lexer only
+/// skips blanks, as the comments are removed and the wrapped lines are joined already. The macros defined
+/// by the compiler itself (under the line markers of "<built-in>" and "<command-line>") are not stored.
+/// It's cached as a file parsed normally, @see ParseFile
 ///
-/// - either line comment or comment blocks will be removed
-/// - all special cases (like multiple comment blocks in one line) can be handled perfectly
-///     except fake comments within quotation marks (like str = "/* fake comment */ // non-comment";)
-///     but this doesn't impact the parsing
+/// @param[in]  file    filename with either absolute or relative path
 ///
-/// @param[in,out]  lines   lines of source code, comments will be removed directly from the lines
-void TypeParser::StripComments(list<string>& lines) const {
-    bool is_block = false;   // whether a comment block starts
-    bool is_changed = false; // whether current line is changed after removing comments
+void TypeParser::ParsePreprocessedFile(const string &file) {
+    preprocessed_ = true;
+    marker_file_ = file;
 
-    string line;
-    size_t pos = 0;
+    ParseFile(file);
 
-    list<string>::iterator block_start, it = lines.begin();
-    while (it != lines.end()) {
-        is_block = is_changed = false;
+    preprocessed_ = false;
+    marker_file_.clear();
 
-        line = *it;
-        pos = 0;
+    cache_.Save();
+}
 
-        Info("parsing line: [" + line + "]");
+/// Get the identity of a file, which is the same through any path to the file
+/// @return false if it cannot be told, e.g. the file doesn't exist or the file system has no inode numbers
+bool TypeParser::GetFileId(const string &file, FileId &id) {
+    struct stat filestat;
+    if (0 != stat(file.c_str(), &filestat) || 0 == filestat.st_ino) return false;
 
-        // search comment start
-        while (string::npos != (pos = line.find(kSlash, pos))) {
-            if (line.length() <= pos+1) break;    // the 1st '/' is at the end of line, so not a comment
+    id = make_pair(static_cast<long long>(filestat.st_dev), static_cast<long long>(filestat.st_ino));
+    return true;
+}
 
-            switch (line.at(pos+1)) {
-            case kSlash:    // line comment
-                line.erase(pos);
-                is_changed = true;
-                break;
+/// Remember a file that's included only once, it's recorded as it changes what later #include does
+void TypeParser::AddOnceFile(const string &file) {
+    Record("O " + file + "\n");
 
-            case kAsterisk: // comment block
-                is_block = true;
-                is_changed = true;
-
-                do {
-                    size_t found = line.find("*/", pos + 2);
-                    if (string::npos != found) {
-                        line.erase(pos, found - pos + 2);
-                        is_block = false;
-                    } else {
-                        line.erase(pos);
-                        is_block = true;
-                        break;
-                    }
-                } while(!is_block && string::npos != (pos = line.find("/*", pos))); 
-                // loop for possible multiple comment blocks on one line
-                break;
+    FileId id;
+    if (GetFileId(file, id)) once_files_.insert(make_pair(id, file));
+}
 
-            default:
-                pos++;  // might be other '/' after this one
-            }        
-        }
+/// Use the cached parsing result of a file, @see Replay
+///
+/// The key of the result only covers the file and the definitions before it, while the files it includes
+/// are parsed in the middle, so they must not be changed either. They're listed at the beginning of the result
+///
+/// @return false if the result cannot be used, then nothing is changed
+bool TypeParser::LoadCachedResult(const string &file, const CacheKey content, const string &log) {
+    istringstream is(log);
+    string line;
 
-        if (!is_changed) {
-            ++it;
-            continue;
-        } else {
-            if (!line.empty())
-                lines.insert(it, line);
+    while (getline(is, line) && 0 == line.compare(0, 2, "H ")) {
+        istringstream fields(line.substr(2));
+        string hash, dependency;
 
-            it = lines.erase(it);
+        if (!(fields >> hash) || fields.get() != ' ' || !getline(fields, dependency)) return false;
+        if (strtoull(hash.c_str(), NULL, 16) != HashFile(dependency)) {
+            LOG_DEBUG("Included file is changed - " << dependency);
+            return false;
         }
+    }
 
-        if (is_block) {
-            block_start = it;
-            while(it != lines.end()) {
-                line = *it;
-                if (string::npos != (pos = line.find("*/"))) {
-                    lines.erase(block_start, ++it);
-
-                    line.erase(0, pos+2);
-                    if (!line.empty()) {
-                        it = lines.insert(it, line);   // insert rest part for checking of possible followed comments
-                    }
-
-                    is_block = false;
-                    break;
-                }
+    header_files_[file] = true;
+    LOG_DEBUG("Loading parsing result from cache - " << file);
 
-                ++it;
-            }
+    // the changes are made again, they're not part of the file including this one
+    string *outer_log = cache_log_;
+    cache_log_ = NULL;
+    if (!Replay(log)) Error("Bad parsing result in cache - " + file);
+    cache_log_ = outer_log;
 
-            if (is_block) {
-                Error("Unclosed comment block exists");
-            }
+    if (NULL != cache_deps_) {
+        for (is.clear(), is.seekg(0); getline(is, line) && 0 == line.compare(0, 2, "H "); ) {
+            cache_deps_->append(line + "\n");
         }
+
+        AddDependency(*cache_deps_, file, content);
     }
+
+    return true;
 }
 
-// Merge wrapped lines into one line 
-// A line will be deemed as line wrap only when the last character is '\'
-void TypeParser::WrapLines(list<string>& lines) const {
-    string line;
+/// hash of a file's content, 0 if it cannot be read
+CacheKey TypeParser::HashFile(const string &file) {
+    CacheKey hash;
+    if (cache_.FindContentHash(file, hash)) return hash;
 
-    list<string>::iterator first, it = lines.begin();
-    while (it != lines.end()) {
-        first = it;
+    MappedFile source;
+    if (!source.Open(file)) return 0;
 
-        line = *it;
-        assert(!line.empty());
+    hash = ParseCache::Hash(source.data(), source.size());
+    cache_.SetContentHash(file, hash);
 
-        while ('\\' == line[line.length()-1] && ++it != lines.end()) {
-            line  = line.substr(0, line.length() - 1);
-            line = rtrim(line) + (*it);
-        }
+    return hash;
+}
 
-        if (it == lines.end()) {
-            Error("Bad syntax: wrap line at last line");
-            break;
-        }
+void TypeParser::AddDependency(string &deps, const string &file, const CacheKey content) {
+    char hash[32];
+    sprintf(hash, "H %016llx ", content);
 
-        if (it != first) {
-            lines.insert(first, line);    // insert merged string before "first" without invalidating the iterators
-            
-            ++it;    // increase so that current line can be erased from the list
-            it = lines.erase(first, it);
-        } else {
-            ++it;
-        }
+    deps.append(hash).append(file).append("\n");
+}
+
+/// hash of the options deciding which files are found, a manifest made with other options is not used
+CacheKey TypeParser::CrawlOptionsHash() const {
+    CacheKey hash = ParseCache::kHashSeed;
+
+    for (size_t i = 0; i < crawler_.extensions().size(); ++i) {
+        hash = ParseCache::Hash("E " + crawler_.extensions()[i] + "\n", hash);
+    }
+    for (size_t i = 0; i < crawler_.excludes().size(); ++i) {
+        hash = ParseCache::Hash("X " + crawler_.excludes()[i] + "\n", hash);
     }
+
+    return hash;
 }
 
-// Merge all lines into a string for easier parsing
-//    with lines delimited by EOL sign
-//
-// NOTE: if there're characters like  ',' or kSemicolon within a line,
-//    split the line into multiple lines
-string TypeParser::MergeAllLines(const list<string> &lines) const {
-    string src, line, part;
-    size_t pos;
-
-    list<string>::const_iterator it = lines.begin();
-    while (it != lines.end()) {
-        line = *it;
-        assert(!line.empty());
-
-        if ('#' == line.at(0)) {  // don't  split pre-processing line
-            src += line + EOL;
-        } else {
-            while (string::npos !=  (pos = line.find_first_of(",;"))) {
-                if (pos == line.length()-1) {
-                    break;
-                } else { // split line
-                    part = line.substr(0, pos + 1);
-                    src += trim(part) + EOL;   // trim splited lines
-
-                    line = line.substr(++pos);
-                }
+/// Load the folders found under the include paths by the last run from the cache folder
+///
+/// Format of the manifest, one line for each item:
+///     manifest 1
+///     O <options hash>                                @see CrawlOptionsHash
+///     P <include path>
+///     D <mtime> <nsec> <inode> <size> <calls> <folder>  folder relative to the include path, @see DirectoryCrawler
+///     F <position> <file>                             header file in the folder above, relative to the include path
+///     S <folder>                                      sub-folder of the folder above
+///
+void TypeParser::LoadManifest() {
+    manifest_.clear();
+    manifest_content_.clear();
+
+    string content;
+    if (!cache_.LoadFile("manifest", content)) return;
+
+    istringstream is(content);
+    string line;
+    char options[32];
+    sprintf(options, "O %016llx", CrawlOptionsHash());
+    if (!getline(is, line) || line != "manifest 1" || !getline(is, line) || line != options) return;
+
+    DirectoryCrawler::FolderMap *folders = NULL;
+    DirectoryCrawler::Folder *folder = NULL;
+    bool broken = false;
+    while (!broken && getline(is, line)) {
+        if (line.length() < 2 || ' ' != line[1]) {
+            broken = true;
+            continue;
+        }
+
+        istringstream fields(line.substr(2));
+        DirectoryCrawler::Entry entry;
+        string name;
+
+        if ('P' == line[0]) {
+            folders = &manifest_[line.substr(2)];
+            folder = NULL;
+        } else if ('D' == line[0] && NULL != folders) {
+            DirectoryCrawler::Folder read;
+            if (!(fields >> read.stamp.mtime >> read.stamp.mtime_nsec >> read.stamp.inode >> read.stamp.size
+                  >> read.calls) || ' ' != fields.get()) {
+                broken = true;
+                continue;
             }
 
-            src += line + EOL;
+            getline(fields, name);
+            folder = &((*folders)[name] = read);
+        } else if ('F' == line[0] && NULL != folder) {
+            broken = !(fields >> entry.position) || ' ' != fields.get() || !getline(fields, entry.name);
+            if (!broken) folder->files.push_back(entry);
+        } else if ('S' == line[0] && NULL != folder) {
+            folder->folders.push_back(line.substr(2));
+        } else {
+            broken = true;
         }
+    }
 
-        ++it;
+    if (broken) {
+        // a broken manifest only means that the folders are read again
+        LOG_DEBUG("Ignoring broken manifest");
+        manifest_.clear();
+        return;
     }
 
-    return src;
+    manifest_content_ = content;
 }
 
-// Trim trailing spaces for each line
-void TypeParser::TrimLines(list<string>& lines) const {
-    string line;
-    list<string>::iterator it = lines.begin();
+/// Save the folders found under the include paths into the cache folder, @see LoadManifest
+void TypeParser::SaveManifest() const {
+    if (!cache_.is_open()) return;
 
-    while (it != lines.end()) {
-        line = *it;
-        if (rtrim(line).compare(*it) != 0) {
-            lines.insert(it, line);
-            it = lines.erase(it);
-        } else {
-            ++it;
+    ostringstream os;
+    char options[32];
+    sprintf(options, "O %016llx", CrawlOptionsHash());
+    os << "manifest 1\n" << options << "\n";
+
+    for (set <string>::const_iterator path = include_paths_.begin(); path != include_paths_.end(); ++path) {
+        map <string, DirectoryCrawler::FolderMap>::const_iterator folders = manifest_.find(*path);
+        if (folders == manifest_.end()) continue;
+
+        os << "P " << *path << "\n";
+        for (DirectoryCrawler::FolderMap::const_iterator it = folders->second.begin(); it != folders->second.end(); ++it) {
+            const DirectoryCrawler::Folder &folder = it->second;
+            os << "D " << folder.stamp.mtime << ' ' << folder.stamp.mtime_nsec << ' ' << folder.stamp.inode << ' '
+               << folder.stamp.size << ' ' << folder.calls << ' ' << it->first << "\n";
+
+            for (size_t i = 0; i < folder.files.size(); ++i) {
+                os << "F " << folder.files[i].position << ' ' << folder.files[i].name << "\n";
+            }
+            for (size_t i = 0; i < folder.folders.size(); ++i) {
+                os << "S " << folder.folders[i] << "\n";
+            }
         }
     }
-}
 
-// Get next token starting from the specified position of the line
-// pos will be moved to after the token if token not at line end
-//
-// Assuming not all of the rest characters are blanks as all lines are trimed before
-// Note: 
-// Among the many punctuations that can be used in C language (like #[(<&|*>)]} ? \' : \", % != /;)
-//   only '_' can be part of a token here
-string TypeParser::GetNextToken(const string line, size_t& pos) const {
-    if (pos >= line.length()) return "";
-
-    // skip blanks
-    while (isspace(line[pos])) pos++;
-    int start = pos;
-    
-    char ch;
-    while(pos < line.length()) {
-        ch = line[pos];
-        if ( isspace(ch) 
-            || (ispunct(ch) && '_' != ch) ) break;
+    if (os.str() != manifest_content_) cache_.StoreFile("manifest", os.str());
+}
 
-        ++pos;  // move to the next character
+/*
+ * Recursively find all the header files under specified folder
+ * and store them into header_files_, the files that're not yet known are also appended to found
+ * 
+ * The header files are also indexed for resolving #include, @see GetFile
+ * The folders are read on multiple threads with more than one job, @see SetJobs
+ *
+ * Folder name can end with either "\\" or "/", or without any
+ *
+ * Assumption: header files end with one of the extensions, ".h" by default (@see SetHeaderExtensions)
+ */
+void TypeParser::FindHeaderFiles(string folder, vector<string> &found) {
+    vector<string> files;
+    include_index_.AddPath(folder, crawler_, jobs_, files, cache_.is_open() ? &manifest_[folder] : NULL);
+
+    for (vector<string>::const_iterator it = files.begin(); it != files.end(); ++it) {
+        // "false" means not yet parsed
+        if (header_files_.insert(make_pair(*it, false)).second) found.push_back(*it);
+        LOG_DEBUG("Found header file: " << *it);
     }
+}
 
-    Debug("Next token: " + line.substr(start, pos-start));
-    return (start == pos) ? "" : line.substr(start, pos-start);
+// search a file from the include paths
+// when found, return full path of the file, else return empty string - it's up to the caller to check the return value
+string TypeParser::GetFile(const string &filename) {
+    return include_index_.Find(filename);
 }
 
 // return true is it's an empty token or it's a qualifer that can be ignored
-bool TypeParser::IsIgnorable(string token) const {
+bool TypeParser::IsIgnorable(const StringView &token) const {
     if (token.empty()) {
         return true;
     } else {
-        return (qualifiers_.end() != qualifiers_.find(token));
+        return (kQualifier == symbols_.Lookup(token).kind);
     }
 }
 
+/// Skip the arguments of an attribute, e.g. ((packed)) of __attribute__((packed))
+///
+/// @param[in]  pos     index of the token after the attribute keyword
+/// @param[in]  end     index to stop at, e.g. the end of a line
+/// @return index of the token after the closing parenthesis, @var pos if there're no parentheses
+size_t TypeParser::SkipParentheses(const TokenList &src, size_t pos, const size_t end) const {
+    if (pos >= end || kLeftParenthesis != src[pos].text[0]) return pos;
+
+    size_t depth = 0;
+    do {
+        if (kLeftParenthesis == src[pos].text[0]) {
+            ++depth;
+        } else if (kRightParenthesis == src[pos].text[0]) {
+            --depth;
+        }
+    } while (++pos < end && depth > 0);
+
+    return pos;
+}
+
 /// Query token type from known keywords/qualifiers or basic/use-defined types
 ///
 /// @param[in]  token   a token
 /// @return the corresponding token type, or kUnresolvedToken if not found
 ///
-TokenTypes TypeParser::GetTokenType(const string &token) const {
-    if (keywords_.end() != keywords_.find(token)) {
-        return keywords_.at(token);
-    } else if (qualifiers_.end() != qualifiers_.find(token)) {        
-        return kQualifier;
-    } else if (basic_types_.end() != basic_types_.find(token)) {
-        return kBasicDataType;
-    } else if (struct_defs_.end() != struct_defs_.find(token)) {        
-        return kStructName;
-    } else if (union_defs_.end() != union_defs_.find(token)) {        
-        return kUnionName;
-    } else if (enum_defs_.end() != enum_defs_.find(token)) {        
-        return kEnumName;
-    } else {
-        return kUnresolvedToken;
-    }
+TokenTypes TypeParser::GetTokenType(const StringView &token) const {
+    return symbols_.Lookup(token).kind;
+}
+
+/// @param[in]  token   id of a token
+TokenTypes TypeParser::GetTokenType(const SymbolId token) const {
+    return symbols_.Info(token).kind;
 }
 
 /// Check whether the token is a number or can be translated into a number
@@ -460,22 +664,24 @@ TokenTypes TypeParser::GetTokenType(const string &token) const {
 /// @return true if 1) the token is a number, or
 ///                 2) the token is a macro that have a number as its value, or
 ///                 3) the token is a const variable that has been assigned to a number
-bool TypeParser::IsNumericToken(const string &token, long& number) const {
+bool TypeParser::IsNumericToken(const StringView &token, long& number) const {
     if (token.empty()) {
         return false;
     }
 
 	bool ret = true;
+    string text = token.str();  // strtol needs a null-terminated string
     
     // stol not supported by gcc, re-write the code to use strtol
-    number = strtol (token.c_str(), NULL, 0);
+    number = strtol (text.c_str(), NULL, 0);
     
     if (0L == number) {	// no valid conversion could be performed
         // the token is not a number, then check whether it can be translated into a number
-        if (const_defs_.find(token) != const_defs_.end()) {
-            number = const_defs_.at(token);
+        map<SymbolId, long>::const_iterator it = const_defs_.find(symbols_.Find(token));
+        if (it != const_defs_.end()) {
+            number = it->second;
         } else {
-            Debug("Cannot parse token <" + token + "> into a number");
+            LOG_DEBUG("Cannot parse token <" << text << "> into a number");
             ret = false;
         }
     }
@@ -490,92 +696,144 @@ bool TypeParser::IsNumericToken(const string &token, long& number) const {
 ///
 /// @note Shouldn't return 0 for unknown data type since "void" type has zero length
 ///
-int TypeParser::GetTypeSize(const string &data_type) const {
-    if (type_sizes_.find(data_type) != type_sizes_.end()) {
-        return type_sizes_.at(data_type);
-    } else if (enum_defs_.find(data_type) != enum_defs_.end()) {
-        return sizeof(int);
+int TypeParser::GetTypeSize(const SymbolId data_type) const {
+    const SymbolInfo &info = symbols_.Info(data_type);
+    if (info.has_size) {
+        return info.size;
     } else {
-        Error("Unknown data type - " + data_type);
+        Error("Unknown data type - " + SymbolName(data_type).str());
         return -1;
     }
 }
 
+/// Make a unique name for an anonymous struct/union/enum type so that it can be stored into map
+SymbolId TypeParser::MakeAnonymousTypeName() {
+    SymbolId type_name;
+    ostringstream os;
+
+    do {
+        os.str("");
+        os << kAnonymousTypePrefix << ++anonymous_count_;
+        type_name = symbols_.Intern(os.str());
+    } while (GetTokenType(type_name) != kUnresolvedToken);
+
+    Record("A\n");
+
+    return type_name;
+}
+
+/// whether it's a fake name made for an anonymous type, @see MakeAnonymousTypeName
+bool TypeParser::IsAnonymousType(const SymbolId type_name) const {
+    StringView name = SymbolName(type_name);
+    return name.length() > kAnonymousTypePrefix.length()
+        && 0 == name.substr(0, kAnonymousTypePrefix.length()).compare(kAnonymousTypePrefix);
+}
+
+// orders symbols by their names rather than their ids, so that the dump is sorted alphabetically
+struct SymbolNameLess {
+    explicit SymbolNameLess(const SymbolTable &symbols) : symbols_(symbols) {}
+    bool operator()(const SymbolId lhs, const SymbolId rhs) const { return symbols_.Name(lhs) < symbols_.Name(rhs); }
+
+    const SymbolTable &symbols_;
+};
+
+// keys of a definition map, sorted by name
+template <typename T>
+static vector<SymbolId> SortedNames(const map<SymbolId, T> &defs, const SymbolTable &symbols) {
+    vector<SymbolId> names;
+    for (typename map<SymbolId, T>::const_iterator it = defs.begin(); it != defs.end(); ++it) {
+        names.push_back(it->first);
+    }
+
+    sort(names.begin(), names.end(), SymbolNameLess(symbols));
+    return names;
+}
+
 /// Dump the extracted type definitions
 void TypeParser::DumpTypeDefs() const {
+    vector<SymbolId> names;
     VariableDeclaration var;
 
     // dump numeric const variables or macros
     cout << "\nconstant values:" << "\n--------------------" << endl;
-    for (map <string, long>::const_iterator it = const_defs_.begin(); it != const_defs_.end(); ++it) {
-        cout << "\t" << it->first << "\t = " << it->second << endl;
+    names = SortedNames(const_defs_, symbols_);
+    for (vector<SymbolId>::const_iterator it = names.begin(); it != names.end(); ++it) {
+        cout << "\t" << SymbolName(*it) << "\t = " << const_defs_.at(*it) << endl;
     }
 
     // dump struct definitions
     cout << "\nstruct definitions:" << "\n--------------------" << endl;
-    for (map <string, list<VariableDeclaration> >::const_iterator it = struct_defs_.begin(); 
-        it != struct_defs_.end(); ++it) {
-
-        cout << "struct " << it->first << ":" << endl;
+    names = SortedNames(struct_defs_, symbols_);
+    for (vector<SymbolId>::const_iterator it = names.begin(); it != names.end(); ++it) {
+        cout << "struct " << SymbolName(*it) << ":" << endl;
         
-        list<VariableDeclaration> members = it->second;
-        while (!members.empty()) {
-            var = members.front();
-            cout << '\t' << var.data_type;
+        const vector<VariableDeclaration> &members = struct_defs_.at(*it);
+        for (vector<VariableDeclaration>::const_iterator member = members.begin(); member != members.end(); ++member) {
+            var = *member;
+            cout << '\t' << SymbolName(var.data_type);
             
             if (var.is_pointer) cout << "* ";
 
-            cout << "\t" << var.var_name;
+            cout << "\t" << SymbolName(var.var_name);
 
             if (0 < var.array_size)
                 cout << "[" << var.array_size << "]";
 
-            cout << "\t(" << var.var_size << ")" << endl;
+            if (var.is_bitfield)
+                cout << " : " << var.bit_width;
 
-            members.pop_front();
+            cout << "\t(" << var.var_size << ")\t@ " << var.offset;
+
+            if (var.is_bitfield)
+                cout << ", bit " << var.bit_offset;
+
+            cout << endl;
         }
 
-        string type = it->first;
-        cout << "\t(size = " << type_sizes_.at(type) << ")\n" << endl;
+        cout << "\t(size = " << GetTypeSize(*it) << ")\n" << endl;
     }
 
     // dump union definitions
     cout << "\nunion definitions:" << "\n--------------------" << endl;
-    for (map <string, list<VariableDeclaration> >::const_iterator itu = union_defs_.begin(); 
-        itu != union_defs_.end(); ++itu) {
-
-        cout << "union " << itu->first << ":" << endl;
+    names = SortedNames(union_defs_, symbols_);
+    for (vector<SymbolId>::const_iterator itu = names.begin(); itu != names.end(); ++itu) {
+        cout << "union " << SymbolName(*itu) << ":" << endl;
         
-        list<VariableDeclaration> members = itu->second;
-        while (!members.empty()) {
-            var = members.front();
-            cout << '\t' << var.data_type;
+        const vector<VariableDeclaration> &members = union_defs_.at(*itu);
+        for (vector<VariableDeclaration>::const_iterator member = members.begin(); member != members.end(); ++member) {
+            var = *member;
+            cout << '\t' << SymbolName(var.data_type);
             
             if (var.is_pointer) cout << "* ";
 
-            cout << "\t" << var.var_name;
+            cout << "\t" << SymbolName(var.var_name);
 
             if (0 < var.array_size)
                 cout << "[" << var.array_size << "]";
 
-            cout << "\t(" << var.var_size << ")" << endl;
+            if (var.is_bitfield)
+                cout << " : " << var.bit_width;
 
-            members.pop_front();
+            cout << "\t(" << var.var_size << ")\t@ " << var.offset;
+
+            if (var.is_bitfield)
+                cout << ", bit " << var.bit_offset;
+
+            cout << endl;
         }
-        cout << "\t(size = " << type_sizes_.at(itu->first) << ")\n" << endl;
+        cout << "\t(size = " << GetTypeSize(*itu) << ")\n" << endl;
     }
 
     // dump enum definitions
     cout << "\nenum definitions:" << "\n--------------------" << endl;
-    for(map <string, list<pair<string, int> > >::const_iterator itv= enum_defs_.begin(); 
-        itv != enum_defs_.end(); ++itv) {
-
-        cout << "enum " << itv->first << ":" << endl; 
+    names = SortedNames(enum_defs_, symbols_);
+    for (vector<SymbolId>::const_iterator itv = names.begin(); itv != names.end(); ++itv) {
+        cout << "enum " << SymbolName(*itv) << ":" << endl; 
         
-        list< pair<string, int> > members = itv->second;
+        list< pair<SymbolId, int> > members = enum_defs_.at(*itv);
         while (!members.empty()) {
-            pair<string, int> var = members.front();
-            cout << '\t' << var.first << "(" << var.second << ")" << endl;
+            pair<SymbolId, int> var = members.front();
+            cout << '\t' << SymbolName(var.first) << "(" << var.second << ")" << endl;
             members.pop_front();
         }
         cout << '\n' << endl; 
@@ -585,104 +843,95 @@ void TypeParser::DumpTypeDefs() const {
 
 /// Get next token - it can either be a special character, or a keyword/identifier
 ///
-/// @param[in]      src     source code
-/// @param[in,out]  pos     start position to parse the code;
-///                         will be updated to the first char after the token after this method is called
-/// @param[out]     token   the next token after @var pos
+/// @param[in]      src     tokens of the source code
+/// @param[in,out]  pos     index of the token to start with;
+///                         will be updated to the index after the token after this method is called
+/// @param[out]     token   the next token from @var pos
 /// @param[in]      cross_line  true by default, false is only used for parsing pre-processing directives
 /// @return         false only when file end is reached 
 ///
 /// @note When cross_line is false, only get next token from current line where @var pos resides
-/// @note Qualifiers defined in @var qualifiers_ are skipped as they don't matter
+/// @note Qualifiers defined in @var qualifiers_ are skipped as they don't matter, and so are attributes
+///       with their arguments, @see ParseAttributes
+/// @note The token refers to the source buffer, no copy is made
 ///
-bool TypeParser::GetNextToken(string src, size_t &pos, string &token, bool cross_line) const {
-    // cross_line=false, only check token from current line
-    if (!cross_line) {
-        size_t p = src.find(EOL, pos);
-        if (string::npos != p) src = src.substr(0, p);
+bool TypeParser::GetNextToken(const TokenList &src, size_t &pos, StringView &token, bool cross_line) const {
+    // skip possible ignorable tokens
+    while (pos < src.size()) {
+        // cross_line=false, only check token from current line
+        if (!cross_line && src[pos].line_start) break;
+
+        token = src[pos++].text;
+        if (token.empty()) continue;
+
+        TokenTypes type = GetTokenType(token);
+        if (kAttributeKeyword == type) {
+            pos = SkipParentheses(src, pos, src.size());
+        } else if (kQualifier != type) {
+            return true;
+        }
     }
 
-    // skip leading blanks or EOL
-    while ( pos < src.length()
-        && (isspace(src[pos]) || EOL == src[pos]) ) pos++;
-    
-    if (pos >= src.length()) {
-        token.clear();
-        return false;
-    }
+    token = StringView();
+    return false;
+}
 
-    int start = pos;
-    size_t ptk = src.find_first_of(kTokenDelimiters, start);
-    if (string::npos == ptk) {
-        token = src.substr(start);
-        pos = src.length();
-    } else if (start == ptk) {
-        pos = ptk + 1;
-        token = string(1, src[ptk]);
-    } else {
-        pos = ptk;
-        token = src.substr(start, ptk - start);
+/// Get the text between quotation marks on the current line, which can be split into several tokens
+/// like "sub/dir.h"
+///
+/// @param pos  position of the token after the opening quotation mark, it's moved after the closing one
+/// @return false if there's no text before the end of line
+bool TypeParser::GetQuotedText(const TokenList &src, size_t &pos, StringView &text) const {
+    StringView token;
+    if (!GetNextToken(src, pos, text, false) || kQuotation == text[0]) return false;
+
+    while (GetNextToken(src, pos, token, false) && kQuotation != token[0]) {
+        text = StringView(text.data(), token.data() + token.length() - text.data());
     }
 
-    // skip possible empty or ignorable tokens
-    while(!token.empty() && IsIgnorable(token)) GetNextToken(src, pos, token);
-
-    return (token.empty() ? false : true);
+    return true;
 }
 
 /// Get the next line
-/// @param[in,out]  pos     start position to parse the code;
+/// @param[in,out]  pos     index of a token in current line;
 ///                         will be updated to end of next line after this method is called
+/// @param[out]     line    tokens of the next line
 /// @return false only when current line is the last line
-bool TypeParser::GetNextLine(string src, size_t &pos, string &line) const {
-    size_t start = src.find(EOL, pos);
-    if (string::npos == start) {
-        pos = src.length();
-        line.clear();
+bool TypeParser::GetNextLine(const TokenList &src, size_t &pos, TokenRange &line) const {
+    // skip rest of current line
+    while (pos < src.size() && !src[pos].line_start) ++pos;
+
+    line.begin = pos;
+    if (pos >= src.size()) {
+        line.end = pos;
         return false;
     }
 
-    ++start;
-    size_t end = src.find(EOL, start);
-    if (string::npos == end) {
-        line = src.substr(start);
-        pos = src.length();
-    } else {
-        assert(end != start); // assert fail only when it's an empty line
-        line = src.substr(start, end - start);
-        pos = end;
-    }
+    while (++pos < src.size() && !src[pos].line_start) {}
+    line.end = pos;
 
-    assert(!trim(line).empty());
     return true;
 }
 
 /// skip current line that @var pos resides
 ///
-/// @param[in]      src     source code
-/// @param[in,out]  pos     start position to parse the code;
-///                         will be updated to the first char of next line after this method is called
-/// store the line content into "line"
-void TypeParser::SkipCurrentLine(const string &src, size_t &pos, string &line) const {
-    if (pos >= src.length()) {
-        Error("SkipCurrentLine() - string offset larger than its length");
-        line.clear();
+/// @param[in]      src     tokens of the source code
+/// @param[in,out]  pos     index of the token after the last one that is read;
+///                         will be updated to the first token of next line after this method is called
+/// @param[out]     line    tokens of current line
+void TypeParser::SkipCurrentLine(const TokenList &src, size_t &pos, TokenRange &line) const {
+    if (0 == pos || pos > src.size()) {
+        Error("SkipCurrentLine() - token index out of range");
+        line.begin = line.end = pos;
         return;
     }
 
-    size_t start = src.rfind(EOL, pos);
-    size_t end = src.find(EOL, pos);
-    if (end == string::npos) {
-        line = src.substr(start+1);    // it's ok even if start = string::npos as it equals -1
-        pos = src.length();
-    } else if (end == pos) {
-        start = src.rfind(EOL, pos-1);
-        line = src.substr(start+1, end-start-1); // it's ok even if start = string::npos
-        pos++;
-    } else {
-        line = src.substr(start+1, end-start-1);
-        pos = end + 1;
-    }
+    // current line is where the last read token resides
+    line.begin = pos - 1;
+    while (line.begin > 0 && !src[line.begin].line_start) --line.begin;
+
+    while (pos < src.size() && !src[pos].line_start) ++pos;
+    line.end = pos;
 }
 
 /// Parse pre-processing directives
@@ -690,6 +939,8 @@ void TypeParser::SkipCurrentLine(const string &src, size_t &pos, string &line) c
 /// Only below directives with the exact formats are supported:
 /// 1) #include "<header filename>"
 /// 2) #define <macro name> <number>
+/// 3) # <line> "<file>" - line markers of preprocessed source
+/// 4) #pragma pack(...), @see ParsePragmaPack
 /// For others, the whole line will be skipped
 ///
 /// @param src  source code
@@ -699,54 +950,281 @@ void TypeParser::SkipCurrentLine(const string &src, size_t &pos, string &line) c
 /// @note when a header file inclusion directive is met, the header file is parsed 
 /// immediately to ensure the correct parsing sequence
 ///
-void TypeParser::ParsePreProcDirective(const string &src, size_t &pos) {
-    string token, last_token, line;
+void TypeParser::ParsePreProcDirective(const TokenList &src, size_t &pos) {
+    StringView token, last_token;
+    TokenRange line;
     long number;
 
+    Stats::Scope scope(Stats::kPreprocessing);
+    Stats::Add(Stats::kDirectives);
+
     GetNextToken(src, pos, token);
     if (0 == token.compare("include")) {
-        assert(GetNextToken(src, pos, token, false));
+        if (!GetNextToken(src, pos, token, false)) {
+            LOG_INFO("Skip #include without a file name");
+            return;
+        }
 
         // only handle header file included with ""
         if (kQuotation == token[token.length()-1]) {
-            // get included header file name
-            assert(GetNextToken(src, pos, token, false));
+            // get included header file name, which can be split into several tokens like "sub/dir.h"
+            StringView name;
+            if (!GetQuotedText(src, pos, name)) {
+                SkipCurrentLine(src, pos, line);
+                LOG_INFO("Skip #include with a bad file name - " << LineToString(src, line));
+                return;
+            }
 
             // parse the header file immediately
-            ParseFile(token);
+            // a file not under the include paths is looked for in the folder of the including file,
+            // else it's opened as it's named, i.e. relative to the current folder
+            string file = GetFile(name.str());
+            size_t slash = current_file_.find_last_of('/');
+            if (file.empty() && string::npos != slash) {
+                struct stat filestat;
+                string relative = current_file_.substr(0, slash + 1) + name.str();
+                if (0 == stat(relative.c_str(), &filestat)) file = relative;
+            }
+            if (file.empty()) file = name.str();
 
-            // ignore the other quotation marks
+            Record("I " + file + "\n");
+            ParseFile(file);
+
+            // ignore the rest of the line
             SkipCurrentLine(src, pos, line);
         } else {
             // ignore angle bracket (<>)
             SkipCurrentLine(src, pos, line);
-            Info("Skip header file included by <> - " + line);
+            LOG_INFO("Skip header file included by <> - " << LineToString(src, line));
+        }
+    } else if (isdigit(static_cast<unsigned char>(token[0]))) {
+        // a line marker of preprocessed source: # <line> "<file>" [<flags>]
+        StringView file;
+        if (GetNextToken(src, pos, token, false) && kQuotation == token[0] && GetQuotedText(src, pos, file)
+            && 0 != file.compare(marker_file_)) {
+            marker_file_ = file.str();
+            LOG_DEBUG("Parsing file - " << marker_file_);
         }
+
+        SkipCurrentLine(src, pos, line);
     } else if (0 == token.compare("define")) {
-        assert(GetNextToken(src, pos, last_token, false));
-                    
-        if (GetNextToken(src, pos, token, false) && IsNumericToken(token, number)) {
-            const_defs_.insert(make_pair(last_token, number));
+        if (!GetNextToken(src, pos, last_token, false)) {
+            LOG_INFO("Skip #define without a name");
+        } else if (preprocessed_ && !marker_file_.empty() && '<' == marker_file_[0]) {
+            // predefined by the compiler, e.g. __STDC__
+            SkipCurrentLine(src, pos, line);
+        } else if (GetNextToken(src, pos, token, false) && IsNumericToken(token, number)) {
+            StoreConstant(symbols_.Intern(last_token), number);
         } else {
             SkipCurrentLine(src, pos, line);
-            Debug("Ignore define - " + line);
+            LOG_DEBUG("Ignore define - " << LineToString(src, line));
         }
+    } else if (0 == token.compare("pragma") && GetNextToken(src, pos, token, false) && 0 == token.compare("pack")) {
+        ParsePragmaPack(src, pos);
     } else {
         SkipCurrentLine(src, pos, line);
-        Info("Skip unsupported pre-processing line - " + line);
+        LOG_INFO("Skip unsupported pre-processing line - " << LineToString(src, line));
     }
 }
 
+/// Parse #pragma pack, which sets the maximum alignment of the members of the structs/unions defined after it
+///
+/// The forms of GCC and MSVC are supported:
+///     #pragma pack(<n>)                   set it, n is a power of 2
+///     #pragma pack()                      no more limit
+///     #pragma pack(push[, <id>][, <n>])   save the current one, then set it if n is given
+///     #pragma pack(pop[, <id>][, <n>])    restore the last saved one, then set it if n is given
+/// the identifiers are ignored, so a pop restores the last one saved whatever it's named
+///
+/// @param pos  position after "pack", it's moved to the end of line
+void TypeParser::ParsePragmaPack(const TokenList &src, size_t &pos) {
+    StringView token;
+    TokenRange line;
+    bool push = false, pop = false;
+    long number = 0;
+
+    while (GetNextToken(src, pos, token, false) && kRightParenthesis != token[0]) {
+        if (kLeftParenthesis == token[0] || kComma == token[0]) continue;
+
+        if (0 == token.compare("push")) {
+            push = true;
+        } else if (0 == token.compare("pop")) {
+            pop = true;
+        } else if (isdigit(static_cast<unsigned char>(token[0]))) {
+            if (!IsNumericToken(token, number) || number <= 0 || 0 != (number & (number - 1))) {
+                SkipCurrentLine(src, pos, line);
+                LOG_INFO("Skip bad #pragma pack - " << LineToString(src, line));
+                return;
+            }
+        }
+    }
+
+    SkipCurrentLine(src, pos, line);
+
+    if (push) pack_stack_.push_back(pack_);
+    if (pop) {
+        if (pack_stack_.empty()) {
+            LOG_INFO("#pragma pack(pop) without push - " << LineToString(src, line));
+        } else {
+            pack_ = pack_stack_.back();
+            pack_stack_.pop_back();
+        }
+    }
+
+    // pack() with no value ends the limit
+    if (number > 0 || (!push && !pop)) pack_ = static_cast<size_t>(number);
+
+    StorePackState();
+}
+
+/// Read the alignment attributes within a range of tokens
+///
+/// The GCC attributes packed and aligned (or __packed__ and __aligned__) are supported, e.g.
+///     __attribute__((packed, aligned(4)))
+/// and __declspec(align(<n>)) of MSVC. The others are ignored, and so are alignments that are not numbers
+///
+/// @param[in]      range       tokens, e.g. a member declaration
+/// @param[in,out]  attributes  what's found is set, the others are kept
+void TypeParser::ParseAttributes(const TokenList &src, const TokenRange &range, AlignAttributes &attributes) const {
+    for (size_t i = range.begin; i < range.end; ++i) {
+        // the attribute keywords start with "__", most tokens are not looked up
+        if ('_' != src[i].text[0] || kAttributeKeyword != GetTokenType(src[i].text)) continue;
+
+        size_t end = SkipParentheses(src, i + 1, range.end);
+        for (++i; i < end; ++i) {
+            const StringView &name = src[i].text;
+
+            if (0 == name.compare("packed") || 0 == name.compare("__packed__")) {
+                attributes.packed = true;
+            } else if (0 == name.compare("aligned") || 0 == name.compare("__aligned__") || 0 == name.compare("align")) {
+                // aligned(<n>), or aligned alone for the biggest alignment
+                long number;
+                if (i + 3 < end && kLeftParenthesis == src[i + 1].text[0] && kRightParenthesis == src[i + 3].text[0]) {
+                    if (IsNumericToken(src[i + 2].text, number) && number > 0) {
+                        attributes.aligned = max(attributes.aligned, static_cast<size_t>(number));
+                    }
+                    i += 3;
+                } else if (i + 1 < end && kLeftParenthesis != src[i + 1].text[0]) {
+                    attributes.aligned = kBiggestAlignment;
+                }
+            }
+        }
+        --i;
+    }
+}
+
+/// Tell whether a header file is included only once, like the multiple-include optimization of GCC
+///
+/// It's true when the file has "#pragma once", or when all its content is within an include guard:
+///     #ifndef <guard> (or #if !defined(<guard>))
+///     #define <guard>
+///     ...
+///     #endif
+/// with nothing but comments out of it, and no #else or #elif of the guard. Macros are never undefined (#undef is
+/// not supported), so such a file changes nothing when it's included again
+///
+/// @param[out] guard   the guard macro, or "#pragma once"
+bool TypeParser::IsIncludedOnce(const TokenList &src, string &guard) const {
+    size_t depth = 0;       // of the conditional directives
+    bool guarded = false;   // the file starts with the guard, which is not closed yet
+
+    for (size_t pos = 0; pos < src.size(); ++pos) {
+        if (!src[pos].line_start || kPoundSign != src[pos].text[0]) continue;
+
+        size_t next = pos + 1;
+        StringView directive, name;
+        if (!GetNextToken(src, next, directive, false)) continue;
+
+        if (0 == directive.compare("pragma") && GetNextToken(src, next, name, false) && 0 == name.compare("once")) {
+            guard = "#pragma once";
+            return true;
+        }
+
+        if (0 == directive.compare("ifndef") || 0 == directive.compare("ifdef") || 0 == directive.compare("if")) {
+            if (0 == pos) {
+                // #ifndef <guard>, or #if !defined(<guard>) or #if !defined <guard>
+                StringView token;
+                if (0 == directive.compare("ifndef")) {
+                    guarded = GetNextToken(src, next, name, false);
+                } else if (0 == directive.compare("if") && GetNextToken(src, next, token, false) && '!' == token[0]
+                           && GetNextToken(src, next, token, false) && 0 == token.compare("defined")) {
+                    guarded = GetNextToken(src, next, name, false)
+                        && ('(' != name[0] || GetNextToken(src, next, name, false));
+                }
+
+                // followed by #define <guard>
+                size_t define = next;
+                while (define < src.size() && !src[define].line_start) ++define;
+
+                StringView defined;
+                guarded = guarded && define < src.size() && kPoundSign == src[define].text[0]
+                    && GetNextToken(src, ++define, token, false) && 0 == token.compare("define")
+                    && GetNextToken(src, define, defined, false) && defined == name;
+                if (guarded) guard = name.str();
+            }
+
+            ++depth;
+        } else if (0 == directive.compare("else") || 0 == directive.compare("elif")) {
+            // the content of the other branch is parsed when the file is included again
+            if (1 == depth) guarded = false;
+        } else if (0 == directive.compare("endif") && depth > 0) {
+            if (0 == --depth && guarded) {
+                // the guard must be closed at the end of file
+                while (next < src.size() && !src[next].line_start) ++next;
+                if (next == src.size()) return true;
+
+                guarded = false;
+            }
+        }
+    }
+
+    return false;
+}
+
+/// Parse source code
+///
+/// @param[in]  src     source code, e.g. the content of a header file
 void TypeParser::ParseSource(const string &src) {
+    ParseSource(src.data(), src.length());
+}
+
+/// Parse source code in a buffer
+///
+/// @param[in]  src     source code buffer, the tokens refer to it directly
+/// @param[in]  size    size of the buffer
+void TypeParser::ParseSource(const char *src, size_t size) {
+    TokenList tokens;
+    {
+        Stats::Scope scope(Stats::kTokenizing);
+
+        tokens.reserve(size / 4);
+
+        Lexer lexer(src, size);
+        lexer.Tokenize(tokens);
+
+        Stats::Add(Stats::kBytes, size);
+        Stats::Add(Stats::kTokens, tokens.size());
+    }
+
+    ParseTokens(tokens);
+}
+
+/// Parse the tokens of source code
+///
+/// @param[in]  src     tokens of the source code
+void TypeParser::ParseTokens(const TokenList &src) {
     size_t pos = 0;
-    string token, last_token, line;
+    StringView token;
+    TokenRange line;
     bool is_typedef = false;
     TokenTypes type;
 
+    Stats::Scope scope(Stats::kParsing);
+
     VariableDeclaration decl;
     bool is_decl = false;
 
-    string type_name;
+    vector<StringView> tokens;
     while (GetNextToken(src, pos, token)) {
         if (token.length() == 1) {
             switch(token[0]) {
@@ -762,7 +1240,7 @@ void TypeParser::ParseSource(const string &src) {
 
             default:
                 SkipCurrentLine(src, pos, line);
-                Debug("Character '" + token + "' unexpected, ignore the line");
+                LOG_DEBUG("Character '" << token << "' unexpected, ignore the line");
             }
         } else {
             type = GetTokenType(token);
@@ -793,8 +1271,10 @@ void TypeParser::ParseSource(const string &src) {
             case kBasicDataType:
                 // only (const) global variable are supported
                 assert(GetRestLine(src, pos, line));
-                if (!ParseAssignExpression(line)) {
-                    Debug("Expression not supported - " + line);
+                tokens.clear();
+                SplitLineIntoTokens(src, line, tokens);
+                if (!ParseAssignExpression(tokens)) {
+                    LOG_DEBUG("Expression not supported - " << LineToString(src, line));
                 }
                 break;
 
@@ -806,15 +1286,18 @@ void TypeParser::ParseSource(const string &src) {
 }
 
 /// Parse enum block
-bool TypeParser::ParseEnum(const bool is_typedef, const string &src, size_t &pos, VariableDeclaration &var_decl, bool &is_decl) {
-	pair<string, int> member;
-	list <pair<string, int> > members;
-	string line, token, next_token, type_name;
+bool TypeParser::ParseEnum(const bool is_typedef, const TokenList &src, size_t &pos, VariableDeclaration &var_decl, bool &is_decl) {
+	pair<SymbolId, int> member;
+	list <pair<SymbolId, int> > members;
+	StringView token, next_token;
+	TokenRange line;
+	vector<StringView> tokens;
+	SymbolId type_name = kNoSymbol;
 
     int last_value = -1;
     bool is_last_member = false;
 
-    assert(!src.empty() && pos < src.length());
+    assert(!src.empty() && pos < src.size());
 
     size_t start = pos; // store the original position for next guess
 
@@ -824,7 +1307,8 @@ bool TypeParser::ParseEnum(const bool is_typedef, const string &src, size_t &pos
     }
     
     // it might be just a simple enum variable declaration like: enum Home home;
-	if (ParseDeclaration(line, var_decl)) {
+	SplitLineIntoTokens(src, line, tokens);
+	if (ParseDeclaration(tokens, var_decl)) {
 		return (is_decl = true);
 	}
 	
@@ -832,7 +1316,7 @@ bool TypeParser::ParseEnum(const bool is_typedef, const string &src, size_t &pos
     pos = start;    // reset the position
 	assert(GetNextToken(src, pos, token));
 	if ('{' != token.at(0)) {
-		type_name = token;
+		type_name = symbols_.Intern(token);
 		assert(GetNextToken(src, pos, token) && kBlockStart == token.at(0));
 	}
 	
@@ -842,51 +1326,48 @@ bool TypeParser::ParseEnum(const bool is_typedef, const string &src, size_t &pos
 	while (GetNextToken(src, pos, token)) {       
         if (kBlockEnd == token.at(0)) { // reach block end
             // process rest part after block end
-            start = 1;
 			assert(GetNextToken(src, pos, token));
+            size_t pos_token = pos - 1;
 			
             if (is_typedef) {
                 // format 1
                 assert(GetNextToken(src, pos, next_token)  && kSemicolon == next_token.at(0));
 
                 is_decl = false;
-                enum_defs_[token] = members;  // type alias
-                type_sizes_[token] = sizeof(int);   // sizeof a enum variable = sizeof(int)
+                SymbolId type_alias = symbols_.Intern(token);
+                StoreEnumDef(type_alias, members);  // type alias
 
-                if (!type_name.empty() && token.compare(type_name) != 0) {
-                    enum_defs_[type_name] = members;  // type name
-                    type_sizes_[type_name] = sizeof(int);
+                if (kNoSymbol != type_name && type_alias != type_name) {
+                    StoreEnumDef(type_name, members);  // type name
                 }
             } else {    // non-typedef
 			    if (kSemicolon == token.at(0)) {
                     // format 2
                     is_decl = false;
-                    assert(!type_name.empty());
-                    enum_defs_[type_name] = members;
-                    type_sizes_[type_name] = sizeof(int);
+                    assert(kNoSymbol != type_name);
+                    StoreEnumDef(type_name, members);
                 } else {
                     // token must be part of a variable declaration
                     // so it must be format 3 or 4
 
-                    if (type_name.empty()) {
+                    if (kNoSymbol == type_name) {
                         // format 4: anonymous type
-                        // generate a unique random name for this type so that it can be stored into map
-                        do {
-                            type_name = kAnonymousTypePrefix + rands();
-                        } while (enum_defs_.end() != enum_defs_.find(type_name));
+                        type_name = MakeAnonymousTypeName();
                     }
                                         
                     is_decl = true;
-                    enum_defs_[type_name] = members;
-                    type_sizes_[type_name] = sizeof(int);
+                    StoreEnumDef(type_name, members);
 
                     if (!GetRestLine(src, pos, line)) {
                         assert(GetNextLine(src, pos, line));
                     }
 
                     // for easier parsing, make a declaration by adding the <type_name> before <var>
-                    line  = type_name + " " + token + " " + line;
-                    if (!ParseDeclaration(line, var_decl)) {
+                    // a copy of the name is used as interning the variable name may move the stored names
+                    string name = SymbolName(type_name).str();
+                    tokens.assign(1, StringView(name));
+                    SplitLineIntoTokens(src, JoinTokenWithLine(pos_token, line), tokens);
+                    if (!ParseDeclaration(tokens, var_decl)) {
                         Error("Bad syntax for enum type of variable declaration after {} block");
                         return false;
                     }
@@ -902,15 +1383,17 @@ bool TypeParser::ParseEnum(const bool is_typedef, const string &src, size_t &pos
             }
 
             // Note: the last enum memeber can only have one token, so the rest line can be empty here!
+            size_t pos_token = pos - 1;
             GetRestLine(src, pos, line);
 
-            line = token + " " + line;
-            if (!ParseEnumDeclaration(line, last_value, member, is_last_member)) {			        
+            tokens.clear();
+            SplitLineIntoTokens(src, JoinTokenWithLine(pos_token, line), tokens);
+            if (!ParseEnumDeclaration(tokens, last_value, member, is_last_member)) {			        
 			    Error("Unresolved enum member declaration syntax");
                 return false;
 		    } 
 
-            Info("Add enum member: " + member.first);
+            LOG_INFO("Add enum member: " << SymbolName(member.first));
             members.push_back(member);
         }
 	}
@@ -944,19 +1427,22 @@ bool TypeParser::ParseEnum(const bool is_typedef, const string &src, size_t &pos
 // after calling this function:
 //     struct/union definitons will be stored into class member struct_defs_ or union_defs_
 //     pos will point to the next kSemicolon following the block end '}',
-//         or equal to src.length() when reaching file end - bad syntax
+//         or equal to src.size() when reaching file end - bad syntax
 //     is_decl returns:
 //     1) false for definition format 1 and 2;
 //     2) true for declaration format 3-5 and "var_decl" argument being updated
 ///
-bool TypeParser::ParseStructUnion(const bool is_struct, const bool is_typedef, const string &src, size_t &pos, VariableDeclaration &var_decl, bool &is_decl) {
+bool TypeParser::ParseStructUnion(const bool is_struct, const bool is_typedef, const TokenList &src, size_t &pos, VariableDeclaration &var_decl, bool &is_decl) {
 	VariableDeclaration member;
-	list <VariableDeclaration> members;
+	vector<VariableDeclaration> members;
 
-	string line, token, next_token;
-    string type_name, type_alias;
+	StringView token, next_token;
+	TokenRange line;
+	vector<StringView> tokens;
+    SymbolId type_name = kNoSymbol;
+    SymbolId type_alias;
 
-    assert(!src.empty() && pos < src.length());
+    assert(!src.empty() && pos < src.size());
 
     size_t start = pos; // store the original position for next guess
 
@@ -966,7 +1452,8 @@ bool TypeParser::ParseStructUnion(const bool is_struct, const bool is_typedef, c
     }
     
     // it might be just a simple struct/union variable declaration as format 5
-	if (ParseDeclaration(line, var_decl)) {
+	SplitLineIntoTokens(src, line, tokens);
+	if (ParseDeclaration(tokens, var_decl)) {
 		return (is_decl = true);
 	}
 	
@@ -974,64 +1461,69 @@ bool TypeParser::ParseStructUnion(const bool is_struct, const bool is_typedef, c
     pos = start;    // reset the position
 	assert(GetNextToken(src, pos, token));
 	if ('{' != token.at(0)) {
-		type_name = token;
+		type_name = symbols_.Intern(token);
 		assert(GetNextToken(src, pos, token) && '{' == token.at(0));
 	}
+
+    // the attributes before the block, e.g. struct __attribute__((packed)) <name> {...}
+    AlignAttributes attributes = AlignAttributes();
+    attributes.pack = pack_;
+    TokenRange head = { start, pos };
+    ParseAttributes(src, head, attributes);
 	
 	// the following part should be:
     // 1) struct/union member declarations within the block
     // 2) something out of the block like "} [<type alias|var>];"
 	while (GetNextToken(src, pos, token)) {       
         if ('}' == token.at(0)) { // reach block end
+            // and the ones after it, up to the end of the declaration
+            TokenRange tail = { pos, pos };
+            while (tail.end < src.size() && kSemicolon != src[tail.end].text[0]) ++tail.end;
+            ParseAttributes(src, tail, attributes);
+
             // process rest part after block end
-            start = 1;
 			assert(GetNextToken(src, pos, token));
+            size_t pos_token = pos - 1;
 			
             if (is_typedef) {
                 // format 1
                 assert(GetNextToken(src, pos, next_token)  && kSemicolon == next_token.at(0));
 
                 is_decl = false;
-                type_alias = token; // token is actually type alias
-                StoreStructUnionDef(is_struct, type_alias, members);
+                type_alias = symbols_.Intern(token); // token is actually type alias
+                StoreStructUnionDef(is_struct, type_alias, members, attributes);
                 
                 // when type_name not empty and not the same as type alias, store a copy in case it's used elsewhere
-                if (!type_name.empty() && type_alias.compare(type_name) != 0) {
-                    if (is_struct) {
-                        struct_defs_[type_name] = members;
-                    } else {
-                        union_defs_[type_name] = members;
-                    }
-
-                    type_sizes_[type_name] = type_sizes_[type_alias];
+                if (kNoSymbol != type_name && type_alias != type_name) {
+                    CopyStructUnionDef(is_struct, type_name, type_alias);
                 }
             } else {    // non-typedef
 			    if (kSemicolon == token.at(0)) {
                     // format 2
                     is_decl = false;
-                    assert(!type_name.empty());
-                    StoreStructUnionDef(is_struct, type_name, members);
+                    assert(kNoSymbol != type_name);
+                    StoreStructUnionDef(is_struct, type_name, members, attributes);
                 } else {
                     // token must be part of a variable declaration
                     // so it must be format 3 or 4
-                    if (type_name.empty()) {
+                    if (kNoSymbol == type_name) {
                         // format 4: anonymous type
-                        // generate a unique random name for this type so that it can be stored into map
-                        do {
-                            type_name = kAnonymousTypePrefix + rands();
-                        } while (struct_defs_.end() != struct_defs_.find(type_name));
+                        type_name = MakeAnonymousTypeName();
                     }
                                         
                     is_decl = true;
-                    StoreStructUnionDef(is_struct, type_name, members);
+                    StoreStructUnionDef(is_struct, type_name, members, attributes);
 
                     if (!GetRestLine(src, pos, line)) {
                         assert(GetNextLine(src, pos, line));
                     }
 
                     // for easier parsing, make a declaration by adding the <type_name> before <var>
-                    line  = type_name + " " + token + " " + line;
-                    if (!ParseDeclaration(line, var_decl)) {
+                    // a copy of the name is used as interning the variable name may move the stored names
+                    string name = SymbolName(type_name).str();
+                    tokens.assign(1, StringView(name));
+                    SplitLineIntoTokens(src, JoinTokenWithLine(pos_token, line), tokens);
+                    if (!ParseDeclaration(tokens, var_decl)) {
                         Error("Bad syntax for struct/union type of variable declaration after {} block");
                         return false;
                     }
@@ -1067,17 +1559,30 @@ bool TypeParser::ParseStructUnion(const bool is_struct, const bool is_typedef, c
 			    members.push_back(member);
             } else {
                 // regular struct/union member declaration, including format 5
+                size_t pos_token = pos - 1;
                 if (!GetRestLine(src, pos, line)) {
                     assert(GetNextLine(src, pos, line));
                 }
 
-                line = token + " " + line;
-                if (!ParseDeclaration(line, member)) {			        
+                TokenRange declaration = JoinTokenWithLine(pos_token, line);
+                tokens.clear();
+                SplitLineIntoTokens(src, declaration, tokens);
+                if (!ParseDeclaration(tokens, member)) {			        
 			        Error("Unresolved struct/union member declaration syntax");
                     return false;
 		        } 
 
-                Info("Add member: " + member.var_name);
+                ParseAttributes(src, declaration, member.attributes);
+
+                // the qualifier is dropped from the data type, it tells how the values are printed;
+                // it's skipped before the first token, so it's looked for back to the start of the line
+                size_t begin = declaration.begin;
+                while (begin > 0 && !src[begin].line_start) --begin;
+                for (size_t i = begin; i < declaration.end && !member.is_unsigned; ++i) {
+                    member.is_unsigned = (0 == src[i].text.compare("unsigned"));
+                }
+
+                LOG_INFO("Add member: " << SymbolName(member.var_name));
                 members.push_back(member);
 		    }
         }
@@ -1086,25 +1591,54 @@ bool TypeParser::ParseStructUnion(const bool is_struct, const bool is_typedef, c
 	return true;
 }
 
-// get rest part of the line
-bool TypeParser::GetRestLine(const string &src, size_t &pos, string &line) const {
-    if (EOL == src[pos]) {
-        line.clear();
+/// get rest part of the line
+///
+/// @param[in,out]  pos     index of the token to start with;
+///                         will be updated to end of current line after this method is called
+/// @param[out]     line    the rest tokens of current line
+/// @return false if there're no more tokens in current line
+bool TypeParser::GetRestLine(const TokenList &src, size_t &pos, TokenRange &line) const {
+    line.begin = pos;
+    if (pos >= src.size() || src[pos].line_start) {
+        line.end = pos;
         return false;
     }
 
-    size_t p = src.find(EOL, pos);
-    if (string::npos != p) {
-        line = src.substr(pos, p-pos);
-        pos = p;
-    } else {
-        line = src.substr(pos);
-        pos = src.length();
-    }
+    while (++pos < src.size() && !src[pos].line_start) {}
+    line.end = pos;
 
     return true;
 }
 
+/// Make a range that starts from a token and ends at the end of a line after it
+///
+/// Parsing a member often needs the token just read plus the rest of the line (or the next line).
+/// As the tokens between them are either none or ignorable, the range covering both is used
+///
+/// @param[in]  token_pos   index of a token
+/// @param[in]  line        rest of the line or the next line after the token, can be empty
+TokenRange TypeParser::JoinTokenWithLine(const size_t token_pos, const TokenRange &line) const {
+    TokenRange range;
+
+    range.begin = token_pos;
+    range.end = (line.begin == line.end) ? token_pos + 1 : line.end;
+    assert(range.end > token_pos);
+
+    return range;
+}
+
+/// Make a printable string of a line, mainly for logging
+string TypeParser::LineToString(const TokenList &src, const TokenRange &line) const {
+    string text;
+
+    for (size_t i = line.begin; i < line.end && i < src.size(); ++i) {
+        if (i != line.begin) text += ' ';
+        text.append(src[i].text.data(), src[i].text.length());
+    }
+
+    return text;
+}
+
 /// Parsing enum member declaration
 ///
 /// Possible formats:
@@ -1113,18 +1647,17 @@ bool TypeParser::GetRestLine(const string &src, size_t &pos, string &line) const
 ///		3) Shenzhen = <value>   // only for last enum member 
 ///		4) Shanghai = <value>,
 ///
-/// @param[in]		line		the declaration of a enum member
+/// @param[in]		tokens		tokens of the declaration of a enum member
 /// @param[in,out]	last_value	[in]the value of last enum member; [out]the value of current enum member
 /// @param[out]		decl		enum member declaration
 /// @param[out]		is_last_member	true for format 2 & 4, else false
-bool TypeParser::ParseEnumDeclaration(const string &line, 
-									  int &last_value, pair<string, int> &decl, bool &is_last_member) const {
+bool TypeParser::ParseEnumDeclaration(const vector<StringView> &tokens, 
+									  int &last_value, pair<SymbolId, int> &decl, bool &is_last_member) const {
     // whether this enum variable is the lastest member of the enum type
     is_last_member = false;
-    vector<string> tokens;
     long number;
 
-    switch (SplitLineIntoTokens(line, tokens)) {
+    switch (tokens.size()) {
     case 1:
         is_last_member = true;
         decl.second = ++last_value;
@@ -1139,7 +1672,7 @@ bool TypeParser::ParseEnumDeclaration(const string &line,
         assert(kEqual == tokens[1].at(0));
         
         if (!IsNumericToken(tokens[2], number)) {
-            Error("Cannot convert token into a number - " + tokens[2]);
+            Error("Cannot convert token into a number - " + tokens[2].str());
             return false;
         }
 
@@ -1151,7 +1684,7 @@ bool TypeParser::ParseEnumDeclaration(const string &line,
         assert(kEqual == tokens[1].at(0) && kComma == tokens[3].at(0));
         
         if (!IsNumericToken(tokens[2], number)) {
-            Error("Cannot convert token into a number - " + tokens[2]);
+            Error("Cannot convert token into a number - " + tokens[2].str());
             return false;
         }
         
@@ -1159,52 +1692,83 @@ bool TypeParser::ParseEnumDeclaration(const string &line,
         break;
 
     default:
-        Error("Bad syntax for enum member declaration - " + line);
+        Error("Bad syntax for enum member declaration - " + (tokens.empty() ? string() : tokens[0].str()));
         return false;
     }
 
-    decl.first = tokens[0];
+    decl.first = symbols_.Intern(tokens[0]);
     return true;
 }
 
+/// Join the words of a basic type name: long long, long double, and "int" after short or long is redundant
+///
+/// @param[in]      tokens  tokens of a declaration
+/// @param[in]      end     index of the first token that cannot be part of the type name
+/// @param[in,out]  index   index of the first word of the type name, and of the last one after it's called
+static string JoinTypeName(const vector<StringView> &tokens, const size_t end, size_t &index) {
+    string type_name = tokens[index].str();
+
+    while (("short" == type_name || "long" == type_name || "long long" == type_name) && index + 1 < end) {
+        if ("int" == tokens[index + 1]) {
+            ++index;
+        } else if ("long" == type_name && ("long" == tokens[index + 1] || "double" == tokens[index + 1])) {
+            type_name += " " + tokens[++index].str();
+        } else {
+            break;
+        }
+    }
+
+    return type_name;
+}
+
 /// Parse a variable declaration
 ///
 /// A declaration can be as complicated as: 
 ///     unsigned char *array[MAX_SIZE]; // qualifiers should be removed from "line" argument
 ///     struct <complex_type> var;      // the struct/union/enum keyword should be removed from "line" argument
+///     unsigned flags : 3;             // a bitfield member, @see TypeParser::ParseBitfield
 /// @note code lines with multiple variables declared consecutively are ignored, like "int a, b, c = MAX;" 
 ///
-/// @param[in]  line    a code line that ends with kSemicolon and is stripped of preceding qualifiers (like unsigned)
-///                     and struct/union/enum keywords
+/// @param[in]  tokens  tokens of a code line that ends with kSemicolon and is stripped of preceding qualifiers
+///                     (like unsigned) and struct/union/enum keywords
 /// @param[out] decl    the variable declaration if the line is parsed successfully
 /// @return             true if the line can be parsed into a variable declaration successfully
 ///
 /// @note type size are calculated will simple consideration of alignment
 /// @note can be improved with consideration of multiple demension array
-bool TypeParser::ParseDeclaration(const string &line, VariableDeclaration &decl) const {
-    assert(!line.empty());
-    if (line[line.length()-1] != kSemicolon) return false;
+bool TypeParser::ParseDeclaration(const vector<StringView> &tokens, VariableDeclaration &decl) const {
+    assert(!tokens.empty());
+    if (tokens.back().at(0) != kSemicolon) return false;
+
+    assert(tokens.size() >= 3);  // even the simplest declaration contains 3 tokens: type var ;
 
-    vector<string> tokens;
-    size_t size = SplitLineIntoTokens(line, tokens);
-    assert(size >= 3);  // even the simplest declaration contains 3 tokens: type var ;
+    decl.offset = 0;
+    decl.attributes = AlignAttributes();
+    decl.is_unsigned = false;
+    if (kColon == tokens[tokens.size() - 3].at(0)) return ParseBitfield(tokens, decl);
+
+    decl.is_bitfield = false;
+    decl.bit_width = decl.bit_offset = 0;
 
     size_t index = 0;
-    decl.data_type = tokens[index];
+    string type_name = JoinTypeName(tokens, tokens.size() - 2, index);
+
+    decl.data_type = symbols_.Intern(type_name);
     decl.is_pointer = false;
 
-    size_t length = GetTypeSize(decl.data_type);
+    // a pointer doesn't need the size of its type, e.g. void *data; or struct Node *next; in Node itself
+    bool is_pointer = (kAsterisk == tokens[index + 1].at(0));
+    size_t length = is_pointer ? abi_.scalar(Abi::kPointer).size : GetTypeSize(decl.data_type);
     if (0 == length) {
-        Debug("Unknown data type - " + decl.data_type);
+        LOG_DEBUG("Unknown data type - " << type_name);
         return false;
     }
 
     if (tokens[++index].at(0) == kAsterisk) {
         decl.is_pointer = true;
-        length = kWordSize_; // size of a pointer is 4 types on a 32-bit system
-        decl.var_name = tokens[++index];
+        decl.var_name = symbols_.Intern(tokens[++index]);
     } else {
-        decl.var_name = tokens[index];
+        decl.var_name = symbols_.Intern(tokens[index]);
     }
 
     if (tokens[++index].at(0) == '[') {
@@ -1213,7 +1777,7 @@ bool TypeParser::ParseDeclaration(const string &line, VariableDeclaration &decl)
             decl.array_size = number;
             length *= number;
         } else {
-            Error("Array size cannot be parsed into a number - " + tokens[index]);
+            Error("Array size cannot be parsed into a number - " + tokens[index].str());
             return false;
         }
     } else {
@@ -1225,20 +1789,72 @@ bool TypeParser::ParseDeclaration(const string &line, VariableDeclaration &decl)
     return true;
 }
 
+/// Parse a bitfield member declaration: type name : width;
+///
+/// The name is missing for an unnamed bitfield, e.g. "int : 0;" that ends the storage unit. The type is int
+/// when it's only "unsigned" or "signed", as they're dropped with the other qualifiers
+///
+/// @param[in]  tokens  tokens of the declaration, the third one from the end is the colon
+/// @param[out] decl    the bitfield member if the line is parsed successfully
+bool TypeParser::ParseBitfield(const vector<StringView> &tokens, VariableDeclaration &decl) const {
+    size_t colon = tokens.size() - 3;
+    long width = 0;
+
+    // a zero is not taken as a number, @see IsNumericToken
+    if ("0" != tokens[colon + 1] && (!IsNumericToken(tokens[colon + 1], width) || width <= 0)) {
+        Error("Bitfield width cannot be parsed into a number - " + tokens[colon + 1].str());
+        return false;
+    }
+
+    // the word before the colon is the name, unless it's a type
+    size_t type_end = colon;
+    decl.var_name = kNoSymbol;
+    if (colon > 0 && !symbols_.Lookup(tokens[colon - 1]).has_size) {
+        type_end = colon - 1;
+        decl.var_name = symbols_.Intern(tokens[type_end]);
+    }
+
+    size_t index = 0;
+    string type_name = (0 == type_end) ? "int" : JoinTypeName(tokens, type_end, index);
+    if (0 != type_end && index + 1 != type_end) {
+        Error("Bad bitfield type - " + type_name);
+        return false;
+    }
+
+    decl.data_type = symbols_.Intern(type_name);
+    decl.is_pointer = false;
+    decl.array_size = 0;
+    decl.is_bitfield = true;
+    decl.bit_width = width;
+    decl.bit_offset = 0;
+
+    // only the basic types and enums can be bitfields, and a bitfield is not wider than its type
+    const SymbolInfo &info = symbols_.Info(decl.data_type);
+    int size = GetTypeSize(decl.data_type);
+    if (size <= 0 || kStructName == info.kind || kUnionName == info.kind
+        || static_cast<size_t>(width) > static_cast<size_t>(size) * 8 || (0 == width && kNoSymbol != decl.var_name)) {
+        Error("Bad bitfield - " + type_name + " " + SymbolName(decl.var_name).str() + " : " + tokens[colon + 1].str());
+        return false;
+    }
+
+    decl.var_size = size;
+
+    return true;
+}
+
 /// Parse assignment expression
 ///
-/// @param[in]  line    an assignment expression with the format: var = number
+/// @param[in]  tokens  tokens of an assignment expression with the format: var = number
 /// @return             true if the line can be parsed successfully, and @var const_defs_ will be updated
 ///
-bool TypeParser::ParseAssignExpression(const string &line) {
-    vector<string> tokens;
+bool TypeParser::ParseAssignExpression(const vector<StringView> &tokens) {
     long number;
 
     // only 4 tokens for an assignment expression: var = number;
-    if (4 == SplitLineIntoTokens(line, tokens) 
+    if (4 == tokens.size() 
         && kEqual == tokens[1].at(tokens[1].length()-1) && kSemicolon == tokens[3].at(tokens[3].length()-1)
         && IsNumericToken(tokens[2], number)) {
-        const_defs_.insert(make_pair(tokens[0], number));
+        StoreConstant(symbols_.Intern(tokens[0]), number);
         return true;
     }
 
@@ -1247,136 +1863,490 @@ bool TypeParser::ParseAssignExpression(const string &line) {
 
 /// split a line into tokens
 ///
-/// @note: keywords that can be ignored will be removed by GetNextToken()
-size_t TypeParser::SplitLineIntoTokens(string line, vector<string> &tokens) const {
-    string token;
-    size_t start = 0;
-    
-    while (GetNextToken(line, start, token)) {
-        tokens.push_back(token);
+/// @param[in]      src     tokens of the source code
+/// @param[in]      line    the line to split
+/// @param[in,out]  tokens  tokens of the line are appended, except those can be ignored
+/// @return number of tokens in @var tokens
+size_t TypeParser::SplitLineIntoTokens(const TokenList &src, const TokenRange &line, vector<StringView> &tokens) const {
+    for (size_t i = line.begin; i < line.end; ++i) {
+        if (src[i].text.empty()) continue;
+
+        TokenTypes type = GetTokenType(src[i].text);
+        if (kAttributeKeyword == type) {
+            i = SkipParentheses(src, i + 1, line.end) - 1;
+        } else if (kQualifier != type) {
+            tokens.push_back(src[i].text);
+        }
     }
 
     return tokens.size();
 }
 
-/// Pad a struct with padding fields for memory alignment
+/// size of a struct/union member of the ABI, the size of the whole array for an array
+size_t TypeParser::GetMemberSize(const VariableDeclaration &decl) const {
+    const SymbolInfo &info = symbols_.Info(decl.data_type);
+    size_t size = decl.is_pointer ? abi_.scalar(Abi::kPointer).size : (info.has_size ? info.size : 0);
+
+    return (decl.array_size > 0) ? size * decl.array_size : size;
+}
+
+/// alignment of a struct/union member of the ABI, an array is aligned as its elements
+///
+/// @param[in]  decl    the member, with its own attributes
+/// @param[in]  packed  whether the struct/union is packed, so is each member
+size_t TypeParser::GetMemberAlign(const VariableDeclaration &decl, const bool packed) const {
+    const SymbolInfo &info = symbols_.Info(decl.data_type);
+    size_t align = 1;
+
+    if (packed || decl.attributes.packed) {
+        // aligned to 1, unless it's aligned explicitly
+    } else if (decl.is_pointer) {
+        align = abi_.scalar(Abi::kPointer).align;
+    } else if (info.has_size && info.align > 0) {
+        align = info.align;
+    }
+
+    return max(align, GetAttributeAlign(decl.attributes.aligned));
+}
+
+/// the alignment given by an aligned attribute, @see AlignAttributes::aligned
+size_t TypeParser::GetAttributeAlign(const size_t aligned) const {
+    return (kBiggestAlignment == aligned) ? abi_.biggest_align() : aligned;
+}
+
+/// Lay out the members of a struct or union in a single pass, and set their offsets
 /// 
-/// @param[in,out] members  struct members, will be inserted with padding fields when needed
-/// @return					struct size after alignment
+/// In a struct each member starts at the next multiple of its alignment of the ABI, the gaps between the
+/// members are the padding; in a union every member starts at 0. The type is aligned as its most aligned
+/// member, but at least to Abi::struct_align, and its size is rounded up to the alignment, @see Abi
+///
+/// The alignment attributes change it as GCC does:
+///     - a packed member, or any member of a packed struct/union, is aligned to 1 instead of its alignment
+///     - then a member with the aligned attribute is aligned to that at least
+///     - then #pragma pack(n) limits the alignment of every member to n, the aligned ones included
+///     - at last a struct/union with the aligned attribute is aligned to that at least
+///
+/// The bitfields are allocated bit by bit, @see PlaceBitfield. Each one gets the offset of a window of its
+/// type size that holds it, and its first bit in that window
+///
+/// @param[in]     is_struct
+/// @param[in]     attributes   alignment attributes of the struct/union
+/// @param[in,out] members  struct/union members with their sizes, their offsets are set
+/// @param[out]    align    alignment of the type
+/// @return					size of the type, with the tail padding
 ///
-/// @note This method is based on kAlignment_ = 4 on 32-bit system since the padding algorithm can be very complicated
-/// considering the different alignment modulus/options of different compiler/OS/CPU
 /// About alignment, @see http://c-faq.com/struct/align.esr.html  
-size_t TypeParser::PadStructMembers(list<VariableDeclaration> &members) {
-    list<VariableDeclaration>::iterator it = members.begin();
-    size_t total = 0;
-    size_t size;
-    size_t last_size = 0;   ///< when last_size>0, padding is needed depending on later members; else no more padding is needed later
-    size_t align_size, pad_size;
-    
-    while (it != members.end()) {
-        size = it->var_size;
+size_t TypeParser::LayoutMembers(const bool is_struct, const AlignAttributes &attributes,
+                                 vector<VariableDeclaration> &members, size_t &align) const {
+    BitfieldUnit unit = { 0, 0, 0 };
+    align = (attributes.packed || attributes.pack > 0) ? 1 : abi_.struct_align();
+
+    for (vector<VariableDeclaration>::iterator it = members.begin(); it != members.end(); ++it) {
+        size_t member_align = GetMemberAlign(*it, attributes.packed);
+        if (attributes.pack > 0) member_align = min(member_align, attributes.pack);
+
+        if (it->is_bitfield) {
+            bool packed = attributes.packed || it->attributes.packed || attributes.pack > 0;
+            if (PlaceBitfield(is_struct, packed, member_align, *it, unit)) align = max(align, member_align);
+            continue;
+        }
 
-        if (0 == (size % kAlignment_)) {	// current member itself is aligned
-            if (last_size > 0) {    // need padding previous members to alignment
-                align_size = static_cast<size_t>(ceil(last_size * 1.0 / kAlignment_) * kAlignment_);
-                pad_size = align_size - last_size;
-                members.insert(it, MakePadField(pad_size));
+        align = max(align, member_align);
 
-				total += align_size;
-            } else {
-				total += size;
-			}
-
-            last_size = 0;
-            ++it;
-        } else {	// current member itself cannot align
-            // size can only be less than 4 (1 or 2) now unless it's an array
-            if (size >= kAlignment_) {
-				if (it->array_size > 0) {
-					Debug("TODO: add array support in PadStructMembers()");
-				} else {
-					Error("Incorrect type size for " + it->var_name);
-				}
-
-                return 0;
+        // the storage unit of the bitfields before it ends
+        unit.bits = max(unit.bits, unit.end);
+        unit.size = 0;
+
+        if (is_struct) {
+            it->offset = ((unit.bits + 7) / 8 + member_align - 1) / member_align * member_align;
+            unit.bits = (it->offset + it->var_size) * 8;
+        } else {
+            it->offset = 0;
+            unit.bits = max(unit.bits, it->var_size * 8);
+        }
+    }
+
+    size_t size = (max(unit.bits, unit.end) + 7) / 8;
+    align = max(align, GetAttributeAlign(attributes.aligned));
+    return (size + align - 1) / align * align;
+}
+
+/// Place a bitfield after the members laid out so far, and set its offset and first bit
+///
+/// By the System V rules (GCC), a bitfield follows the previous member bit by bit, unless it would cross a
+/// boundary of its alignment that it doesn't fit in with the bits before it; then it starts at that boundary.
+/// A zero-width one moves to the next boundary only. The boundaries are not kept when packed: the bitfields of
+/// packed structs or under #pragma pack are laid out bit by bit. Only the named bitfields align the struct.
+///
+/// By the Microsoft rules (Abi::ms_bitfields), consecutive bitfields share a storage unit of their type size
+/// as long as their type sizes are the same and they fit in; otherwise a new unit starts at the next multiple
+/// of its alignment. A zero-width one ends the unit, it's ignored when it doesn't follow a bitfield.
+/// Any bitfield aligns the struct, the unnamed ones too.
+///
+/// In a union every bitfield starts at bit 0 of offset 0.
+///
+/// @param[in]     is_struct
+/// @param[in]     packed   whether the bitfield is packed, or the struct/union is packed
+/// @param[in]     align    alignment of the bitfield, with the attributes
+/// @param[in,out] decl     the bitfield, its offset and bit_offset are set
+/// @param[in,out] unit     end of the members laid out so far, and the storage unit of the previous bitfield
+/// @return true if the bitfield aligns the struct/union
+bool TypeParser::PlaceBitfield(const bool is_struct, const bool packed, const size_t align, VariableDeclaration &decl,
+                               BitfieldUnit &unit) const {
+    size_t align_bits = align * 8;
+    size_t type_bits = decl.var_size * 8;
+    size_t bit = 0;             // where the bitfield starts in the struct
+    bool aligns = (kNoSymbol != decl.var_name || abi_.ms_bitfields());
+
+    if (!is_struct) {
+        unit.bits = max(unit.bits, abi_.ms_bitfields() ? type_bits : decl.bit_width);
+    } else if (abi_.ms_bitfields()) {
+        if (0 == decl.bit_width) {
+            aligns = (unit.size > 0);
+            if (aligns) unit.bits = (unit.end + align_bits - 1) / align_bits * align_bits;
+            unit.size = 0;
+            bit = unit.bits;
+        } else {
+            if (unit.size != decl.var_size || unit.bits + decl.bit_width > unit.end) {
+                size_t start = max(unit.bits, unit.end);
+                unit.bits = (start + align_bits - 1) / align_bits * align_bits;
+                unit.size = decl.var_size;
+                unit.end = unit.bits + type_bits;
             }
 
-            if (0 == last_size) {// last member is aligned
-                last_size = size;
-				++it;
-            } else if (0 == (size + last_size) % kAlignment_) {
-                total += size + last_size;
-                last_size = 0;
-                ++it;
-            } else if (1 == last_size) {
-				if (1 == size) {
-					last_size += 1;
-					++it;
-				} else if (2 == size) {
-					members.insert(it, MakePadField(1));
-					total += kAlignment_;
-					last_size = 0;
-					++it;
-				} else {
-					Error("Bad member size - " + size);
-					return 0;
-				}
-			} else if (2 == last_size) {
-				assert (1 == size);
-                members.insert(++it, MakePadField(1));
-                total += kAlignment_;
-                last_size = 0;
-            } else {
-				Error("Bad alignment");
-				return 0;
-			}
+            bit = unit.bits;
+            unit.bits += decl.bit_width;
+        }
 
+        decl.offset = (unit.size > 0) ? (unit.end - type_bits) / 8 : bit / 8;
+        decl.bit_offset = bit - decl.offset * 8;
+        return aligns;
+    } else if (0 == decl.bit_width) {
+        aligns = false;
+        unit.bits = (unit.bits + align_bits - 1) / align_bits * align_bits;
+        bit = unit.bits;
+    } else {
+        if (!packed && unit.bits % align_bits + decl.bit_width > type_bits) {
+            unit.bits = (unit.bits + align_bits - 1) / align_bits * align_bits;
         }
+
+        bit = unit.bits;
+        unit.bits += decl.bit_width;
     }
 
-    return total;
+    // the window of the type size that holds it
+    size_t window_align = min(align, decl.var_size);
+    decl.offset = packed ? bit / 8 : bit / (window_align * 8) * window_align;
+    decl.bit_offset = bit - decl.offset * 8;
+    return aligns;
 }
 
-size_t TypeParser::CalcUnionSize(const list<VariableDeclaration> &members) const {
-    size_t size = 0;
-    for (list<VariableDeclaration>::const_iterator it = members.begin(); it != members.end(); ++ it) {
-        size = max(size, it->var_size);
+/// Store the definition and size of a struct or union
+///
+/// The members get their sizes and offsets of the ABI, @see TypeParser::LayoutMembers
+///
+void TypeParser::StoreStructUnionDef(const bool is_struct, const SymbolId type_name, vector<VariableDeclaration> &members,
+                                     const AlignAttributes &attributes) {
+    Stats::Add(Stats::kDeclarations);
+
+    // the sizes of the current ABI, a cached definition may be parsed for another one
+    for (vector<VariableDeclaration>::iterator it = members.begin(); it != members.end(); ++it) {
+        it->var_size = GetMemberSize(*it);
     }
-    
-    if (0 != size % kAlignment_) {
-        size = static_cast<size_t> (ceil(size * 1.0 / kAlignment_) * kAlignment_);
+
+    if (cache_.is_open()) {
+        ostringstream os;
+        os << (is_struct ? "S " : "U ") << SymbolName(type_name) << ' ' << members.size() << ' '
+           << attributes.packed << ' ' << attributes.aligned << ' ' << attributes.pack << '\n';
+
+        for (vector<VariableDeclaration>::const_iterator it = members.begin(); it != members.end(); ++it) {
+            os << SymbolName(it->data_type) << ' ' << ((kNoSymbol != it->var_name) ? SymbolName(it->var_name) : "-")
+               << ' ' << it->array_size << ' ' << it->is_pointer << ' ' << it->var_size << ' '
+               << it->attributes.packed << ' ' << it->attributes.aligned << ' ' << it->is_bitfield << ' '
+               << it->bit_width << ' ' << it->is_unsigned << '\n';
+        }
+
+        Record(os.str());
     }
 
-    return size;
+    Stats::Scope scope(Stats::kLayout);
+    LayoutStructUnion(is_struct, type_name, members, attributes);
 }
 
-VariableDeclaration TypeParser::MakePadField(const size_t size) const {
-    VariableDeclaration var;
+/// Lay out a struct or union with the sizes of its members, and store it
+void TypeParser::LayoutStructUnion(const bool is_struct, const SymbolId type_name, vector<VariableDeclaration> &members,
+                                   const AlignAttributes &attributes) {
+    size_t align;
+    size_t size = LayoutMembers(is_struct, attributes, members, align);
 
-    var.var_name = kPaddingFieldName;
-    var.var_size = size;
-    var.data_type = "char";
-    var.array_size = 0;
-    var.is_pointer = false;
-    
-    return var;
+    if (attributes.packed || attributes.aligned > 0 || attributes.pack > 0) {
+        layout_attributes_[type_name] = attributes;
+    } else {
+        layout_attributes_.erase(type_name);
+    }
+
+    if (is_struct) {
+        struct_defs_[type_name] = members;
+        RegisterType(type_name, kStructName, size, align);
+    } else {
+        union_defs_[type_name] = members;
+        RegisterType(type_name, kUnionName, size, align);
+    }
 }
 
-/// Store the definition and size of a struct or union
-///
-/// For structs, the members are padded based on alignment, @see TypeParser::PadStructMembers
-///
-void TypeParser::StoreStructUnionDef(const bool is_struct, const string &type_name, list<VariableDeclaration> &members) {
-    size_t size;
+/// Store a copy of a struct/union definition under another name, e.g. the type name of a typedef
+void TypeParser::CopyStructUnionDef(const bool is_struct, const SymbolId type_name, const SymbolId type_alias) {
+    if (cache_.is_open()) {
+        ostringstream os;
+        os << "T " << is_struct << ' ' << SymbolName(type_name) << ' ' << SymbolName(type_alias) << '\n';
+        Record(os.str());
+    }
+
+    const SymbolInfo &alias = symbols_.Info(type_alias);
+    map<SymbolId, AlignAttributes>::const_iterator attributes = layout_attributes_.find(type_alias);
+    if (attributes != layout_attributes_.end()) {
+        layout_attributes_[type_name] = attributes->second;
+    } else {
+        layout_attributes_.erase(type_name);
+    }
 
     if (is_struct) {
-        size = PadStructMembers(members);
-        struct_defs_[type_name] = members;  
+        struct_defs_[type_name] = struct_defs_[type_alias];
+        RegisterType(type_name, kStructName, alias.size, alias.align);
     } else {
-        size = CalcUnionSize(members);
-        union_defs_[type_name] = members;
+        union_defs_[type_name] = union_defs_[type_alias];
+        RegisterType(type_name, kUnionName, alias.size, alias.align);
+    }
+}
+
+/// Store the definition of a enum, the size of a enum variable is the one of the ABI, usually sizeof(int)
+void TypeParser::StoreEnumDef(const SymbolId type_name, const list< pair<SymbolId, int> > &members) {
+    Stats::Add(Stats::kDeclarations);
+
+    if (cache_.is_open()) {
+        ostringstream os;
+        os << "E " << SymbolName(type_name) << ' ' << members.size() << '\n';
+
+        for (list< pair<SymbolId, int> >::const_iterator it = members.begin(); it != members.end(); ++it) {
+            os << SymbolName(it->first) << ' ' << it->second << '\n';
+        }
+
+        Record(os.str());
+    }
+
+    enum_defs_[type_name] = members;
+    RegisterType(type_name, kEnumName, abi_.scalar(Abi::kEnum).size, abi_.scalar(Abi::kEnum).align);
+}
+
+/// Record what a type name stands for into the symbol table, so that it's answered by a single lookup
+///
+/// The size is always updated, while the kind is kept when the name is already known as something
+/// that takes precedence: keywords/qualifiers/basic types first, then struct, union and enum names
+/// (which is the order of @enum TokenTypes)
+void TypeParser::RegisterType(const SymbolId type_name, const TokenTypes kind, const size_t size, const size_t align) {
+    SymbolInfo &info = symbols_.Info(type_name);
+
+    if (kUnresolvedToken == info.kind || kind < info.kind) {
+        info.kind = kind;
+    }
+
+    info.has_size = true;
+    info.size = size;
+    info.align = align;
+
+    switch (kind) {
+    case kStructName:
+        info.struct_def = &struct_defs_.at(type_name);
+        break;
+
+    case kUnionName:
+        info.union_def = &union_defs_.at(type_name);
+        break;
+
+    case kEnumName:
+        info.enum_def = &enum_defs_.at(type_name);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/// Store a numeric constant, the first definition takes effect
+void TypeParser::StoreConstant(const SymbolId name, const long value) {
+    Stats::Add(Stats::kDeclarations);
+
+    if (cache_.is_open()) {
+        ostringstream os;
+        os << "C " << SymbolName(name) << ' ' << value << '\n';
+        Record(os.str());
+    }
+
+    const_defs_.insert(make_pair(name, value));
+}
+
+/// Record the #pragma pack state, it's part of the parsing result as it changes the types defined after it
+void TypeParser::StorePackState() {
+    if (!cache_.is_open()) return;
+
+    ostringstream os;
+    os << "P " << pack_ << ' ' << pack_stack_.size();
+    for (vector<size_t>::const_iterator it = pack_stack_.begin(); it != pack_stack_.end(); ++it) {
+        os << ' ' << *it;
+    }
+    os << '\n';
+
+    Record(os.str());
+}
+
+/// Record a change made to the type definitions
+///
+/// All the changes made by parsing a file make up its parsing result that's stored into the cache,
+/// and they're also chained into a digest of the current definitions, so that a cached result is only used
+/// when the file is parsed after the same definitions
+void TypeParser::Record(const string &event) {
+    if (!cache_.is_open()) return;
+
+    state_digest_ = ParseCache::Hash(event, state_digest_);
+    if (NULL != cache_log_) cache_log_->append(event);
+}
+
+/// Make the changes recorded in a parsing result again
+///
+/// A parsing result consists of lines of the below formats, the names are identifiers without blanks:
+///     H <content hash> <file>     file included directly or indirectly, 0 for a file that cannot be read
+///     I <file>                    file included, which is parsed (or loaded from the cache) again
+///     O <file>                    file included only once, @see IsIncludedOnce
+///     C <name> <value>            numeric constant
+///     A                           a name is made for an anonymous type
+///     S|U <name> <count> <packed> <aligned> <pack>
+///                                 struct/union definition with its attributes, followed by <count> lines
+///                                 of its members:
+///         <data_type> <var_name> <array_size> <is_pointer> <var_size> <packed> <aligned> <is_bitfield>
+///         <bit_width> <is_unsigned>, the data type may have blanks, an unnamed bitfield has "-" as its name
+///     T <is_struct> <name> <alias> copy of a struct/union definition
+///     E <name> <count>            enum definition followed by <count> lines of its members:
+///         <name> <value>
+///     P <pack> <count> <saved>...  #pragma pack state, with the <count> ones saved by push
+///
+/// @return false if the log is malformed, the changes before the bad line are still made
+bool TypeParser::Replay(const string &log) {
+    istringstream is(log);
+    string line, kind, name;
+
+    while (getline(is, line)) {
+        istringstream fields(line);
+        if (!(fields >> kind) || 1 != kind.length()) return false;
+
+        switch (kind[0]) {
+        case 'H':
+            break;  // files included, @see LoadCachedResult
+
+        case 'I':
+            if (line.length() <= 2) return false;
+
+            Record(line + "\n");
+            ParseFile(line.substr(2));
+            break;
+
+        case 'O':
+            if (line.length() <= 2) return false;
+
+            AddOnceFile(line.substr(2));
+            break;
+
+        case 'C': {
+            long value;
+            if (!(fields >> name >> value)) return false;
+
+            StoreConstant(symbols_.Intern(name), value);
+            break;
+        }
+
+        case 'A':
+            MakeAnonymousTypeName();
+            break;
+
+        case 'S':
+        case 'U': {
+            size_t count;
+            AlignAttributes attributes;
+            if (!(fields >> name >> count >> attributes.packed >> attributes.aligned >> attributes.pack)) return false;
+
+            vector<VariableDeclaration> members;
+            for (size_t i = 0; i < count && getline(is, line); ++i) {
+                // the data type can be several words, e.g. long long, the other fields are read from the end
+                size_t blank = line.length();
+                for (int field = 0; field < 9 && string::npos != blank; ++field) {
+                    blank = (blank > 0) ? line.rfind(' ', blank - 1) : string::npos;
+                }
+                if (string::npos == blank || 0 == blank) return false;
+
+                istringstream member(line.substr(blank + 1));
+                string var_name;
+                VariableDeclaration var = VariableDeclaration();
+
+                if (!(member >> var_name >> var.array_size >> var.is_pointer >> var.var_size
+                      >> var.attributes.packed >> var.attributes.aligned >> var.is_bitfield >> var.bit_width
+                      >> var.is_unsigned)) {
+                    return false;
+                }
+
+                var.data_type = symbols_.Intern(line.substr(0, blank));
+                var.var_name = ("-" == var_name) ? kNoSymbol : symbols_.Intern(var_name);
+                members.push_back(var);
+            }
+
+            if (members.size() != count) return false;
+            StoreStructUnionDef('S' == kind[0], symbols_.Intern(name), members, attributes);
+            break;
+        }
+
+        case 'T': {
+            bool is_struct;
+            string alias;
+            if (!(fields >> is_struct >> name >> alias)) return false;
+
+            CopyStructUnionDef(is_struct, symbols_.Intern(name), symbols_.Intern(alias));
+            break;
+        }
+
+        case 'E': {
+            size_t count;
+            if (!(fields >> name >> count)) return false;
+
+            list< pair<SymbolId, int> > members;
+            for (size_t i = 0; i < count && getline(is, line); ++i) {
+                istringstream member(line);
+                string member_name;
+                int value;
+
+                if (!(member >> member_name >> value)) return false;
+                members.push_back(make_pair(symbols_.Intern(member_name), value));
+            }
+
+            if (members.size() != count) return false;
+            StoreEnumDef(symbols_.Intern(name), members);
+            break;
+        }
+
+        case 'P': {
+            size_t count;
+            if (!(fields >> pack_ >> count)) return false;
+
+            pack_stack_.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                if (!(fields >> pack_stack_[i])) return false;
+            }
+
+            StorePackState();
+            break;
+        }
+
+        default:
+            return false;
+        }
     }
 
-    type_sizes_[type_name] = size;
-}
\ No newline at end of file
+    return true;
+}
@@ -0,0 +1,86 @@
+/// Copyright(c) 2013 Frank Fang
+///
+/// Run independent tasks on multiple threads
+///
+/// @author Frank Fang (fanghm@gmail.com)
+/// @date   2013/07/06
+
+#ifndef WIN32
+#include <pthread.h>
+#include <unistd.h>     // sysconf
+#endif
+
+#include <vector>
+
+#include "WorkerPool.h"
+
+using namespace std;
+
+#ifndef WIN32
+/// state shared by the workers of one run
+typedef struct {
+    pthread_mutex_t     lock;
+    size_t              next;       ///< index of the next task to pick up
+    size_t              count;
+    WorkerPool::Task    task;
+    void               *context;
+} WorkerState;
+
+static void *Work(void *arg) {
+    WorkerState *state = static_cast<WorkerState *>(arg);
+
+    for (;;) {
+        pthread_mutex_lock(&state->lock);
+        size_t index = state->next++;
+        pthread_mutex_unlock(&state->lock);
+
+        if (index >= state->count) break;
+        state->task(index, state->context);
+    }
+
+    return NULL;
+}
+
+void WorkerPool::Run(size_t threads, size_t count, Task task, void *context) {
+    WorkerState state;
+    pthread_mutex_init(&state.lock, NULL);
+    state.next = 0;
+    state.count = count;
+    state.task = task;
+    state.context = context;
+
+    if (threads > count) threads = count;
+
+    // the caller thread works too, so one thread less is created
+    vector<pthread_t> workers;
+    for (size_t i = 1; i < threads; ++i) {
+        pthread_t worker;
+        if (0 != pthread_create(&worker, NULL, Work, &state)) break;   // the started ones take over the tasks
+
+        workers.push_back(worker);
+    }
+
+    Work(&state);
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&state.lock);
+}
+
+size_t WorkerPool::ProcessorCount() {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? static_cast<size_t>(count) : 1;
+}
+#else
+void WorkerPool::Run(size_t threads, size_t count, Task task, void *context) {
+    for (size_t i = 0; i < count; ++i) {
+        task(i, context);
+    }
+}
+
+size_t WorkerPool::ProcessorCount() {
+    return 1;
+}
+#endif
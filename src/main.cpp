@@ -16,15 +16,23 @@
 
 #ifndef WIN32
 #include <unistd.h>
+#include <getopt.h>     // getopt_long
 #endif
 
+#include <stdlib.h>     // atoi
+
 #include <string>
 #include <iostream>
 #include <set>
+#include <vector>
 
 #include "utility.h"
+#include "Abi.h"
 #include "TypeParser.h"
 #include "DataReader.h"
+#include "WorkerPool.h"
+#include "TypeDatabase.h"
+#include "Stats.h"
 
 using namespace std;
 
@@ -32,13 +40,36 @@ using namespace std;
 LogLevels g_log_level = kInfo;
 
 void usage(char* prog) {
-    cout << "Usage:\n\t" << prog << " -s <struct_name> -b <binary_file> -i<inclue_path> [-h]" << endl;
+    cout << "Usage:\n\t" << prog << " -s <struct_name> -b <binary_file> -i<inclue_path> [-j <jobs>] [-c <cache_folder>] [-e <extension>] [-x <pattern>] [-w <db_file>] [--abi=<abi>] [--stats[=json]] [--perf] [-h]" << endl;
+    cout << "\t" << prog << " -s <struct_name> -b <binary_file> -t <db_file> [--stats[=json]] [--perf]" << endl;
+    cout << "\t" << prog << " -s <struct_name> -b <binary_file> -p <preprocessed_file> [-c <cache_folder>] [-w <db_file>]" << endl;
+    cout << "\t-j <jobs>\tnumber of threads to read header files, 0 for the number of processors" << endl;
+    cout << "\t-c <cache_folder>\tkeep parsing results in the folder, unchanged header files are not parsed again" << endl;
+    cout << "\t-e <extension>\textension of the header files, e.g. .hpp, can be given more than once, .h by default" << endl;
+    cout << "\t-x <pattern>\tskip the files and folders under the include paths matching a glob pattern, e.g. test*" << endl;
+    cout << "\t-w <db_file>\twrite the parsed type definitions into a type database file" << endl;
+    cout << "\t-t <db_file>\tread the type definitions from a type database file instead of parsing header files" << endl;
+    cout << "\t-p <preprocessed_file>\tparse the output of gcc -E -dD instead of the header files under the include paths" << endl;
+    cout << "\t--abi=<abi>\tlay the types out for an ABI: ilp32 (default), lp64 or llp64, optionally followed by overrides" << endl;
+    cout << "\t\tlike lp64,long_double=8:8,struct_align=4; given more than once with -w, a database is written for each" << endl;
+    cout << "\t\tABI into <db_file>.<abi>" << endl;
+    cout << "\t--stats[=json]\tprint the time of each phase and the counters at the end, as a table or as JSON" << endl;
+    cout << "\t--perf\tcount the hardware events (cycles, cache misses...) of each phase too, printed with --stats" << endl;
 }
 
 #ifndef WIN32
-void ParseOptions(int argc, char **argv, string &struct_name, string &bin_file, set<string> &inc_paths) {
-    char c;
-    while ((c = getopt (argc, argv, "s:b:i:h")) != -1) {
+void ParseOptions(int argc, char **argv, string &struct_name, string &bin_file, set<string> &inc_paths, size_t &jobs,
+                  string &cache_folder, string &db_out, string &db_in, vector<string> &extensions,
+                  vector<string> &excludes, string &stats, string &preprocessed, vector<string> &abis) {
+    static const struct option kLongOptions[] = {
+        { "stats", optional_argument, NULL, 'S' },
+        { "perf", no_argument, NULL, 'P' },
+        { "abi", required_argument, NULL, 'A' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int c;
+    while ((c = getopt_long (argc, argv, "s:b:i:j:c:e:x:w:t:p:h", kLongOptions, NULL)) != -1) {
         switch (c) {
         case 's':
             struct_name = string(optarg);
@@ -53,12 +84,53 @@ void ParseOptions(int argc, char **argv, string &struct_name, string &bin_file,
             inc_paths.insert(string(optarg));
             break;
 
+        case 'j':
+            jobs = (atoi(optarg) > 0) ? atoi(optarg) : WorkerPool::ProcessorCount();
+            break;
+
+        case 'c':
+            cache_folder = string(optarg);
+            break;
+
+        case 'e':
+            extensions.push_back(string(optarg));
+            break;
+
+        case 'x':
+            excludes.push_back(string(optarg));
+            break;
+
+        case 'w':
+            db_out = string(optarg);
+            break;
+
+        case 't':
+            db_in = string(optarg);
+            break;
+
+        case 'p':
+            preprocessed = string(optarg);
+            break;
+
+        case 'S':
+            stats = (NULL != optarg) ? string(optarg) : "table";
+            if ("table" != stats && "json" != stats) usage(argv[0]);
+            break;
+
+        case 'P':
+            if (!Stats::EnableEvents()) Error("Hardware events are not available, only the times are reported");
+            break;
+
+        case 'A':
+            abis.push_back(string(optarg));
+            break;
+
         default:
             usage(argv[0]);
         }
     }
 
-    if (struct_name.empty() || bin_file.empty() || inc_paths.empty()) {
+    if (struct_name.empty() || bin_file.empty() || (inc_paths.empty() && db_in.empty() && preprocessed.empty())) {
         usage(argv[0]);
         return;
     }
@@ -71,7 +143,9 @@ void ParseOptions(int argc, char **argv, string &struct_name, string &bin_file,
     }
 }
 #else
-void ParseOptions(int argc, char **argv, string &struct_name, string &bin_file, set<string> &inc_paths) {
+void ParseOptions(int argc, char **argv, string &struct_name, string &bin_file, set<string> &inc_paths, size_t &jobs,
+                  string &cache_folder, string &db_out, string &db_in, vector<string> &extensions,
+                  vector<string> &excludes, string &stats, string &preprocessed, vector<string> &abis) {
     struct_name = "Employee";
     bin_file    = "../test/Employee.bin";
     inc_paths.insert("../test");
@@ -79,14 +153,55 @@ void ParseOptions(int argc, char **argv, string &struct_name, string &bin_file,
 #endif
 
 int main(int argc, char **argv) {
-	string struct_name, bin_file;
+	string struct_name, bin_file, cache_folder, db_out, db_in, stats, preprocessed;
     set<string> inc_paths;
+    vector<string> extensions, excludes, abis;
+    size_t jobs = 1;
     
-    ParseOptions(argc, argv, struct_name, bin_file, inc_paths);
+    ParseOptions(argc, argv, struct_name, bin_file, inc_paths, jobs, cache_folder, db_out, db_in, extensions, excludes,
+                 stats, preprocessed, abis);
+
+    // the ABIs are checked before anything is parsed
+    vector<Abi> targets(abis.size());
+    for (size_t i = 0; i < abis.size(); ++i) {
+        if (!targets[i].Parse(abis[i])) return 1;
+    }
+
+    if (!db_in.empty()) {
+        // the header files are not needed at all when the definitions come from a type database
+        TypeDatabase types;
+        if (types.Open(db_in)) {
+            DataReader reader(types, bin_file);
+            reader.PrintTypeData(struct_name, false/* struct */);
+        }
+
+        if (!stats.empty()) Stats::Print(cout, "json" == stats);
+        return 0;
+    }
     
     TypeParser parser;
     parser.SetIncludePaths(inc_paths);
-    parser.ParseFiles();
+    parser.SetJobs(jobs);
+    if (!extensions.empty()) parser.SetHeaderExtensions(extensions);
+    parser.SetExcludes(excludes);
+    if (!cache_folder.empty()) parser.SetCacheFolder(cache_folder);
+    if (!targets.empty()) parser.SetAbi(targets[0]);
+    if (preprocessed.empty()) {
+        parser.ParseFiles();
+    } else {
+        parser.ParsePreprocessedFile(preprocessed);
+    }
+    parser.DumpTypeDefs();
+    if (targets.size() > 1 && !db_out.empty()) {
+        // the types are laid out again for each ABI, the header files are parsed once only
+        for (size_t i = 0; i < targets.size(); ++i) {
+            parser.SetAbi(targets[i]);
+            TypeDatabase::Write(parser, db_out + "." + targets[i].name());
+        }
+    } else if (!db_out.empty()) {
+        TypeDatabase::Write(parser, db_out);
+    }
+    if (!stats.empty()) Stats::Print(cout, "json" == stats);
     
     //DataReader reader(parser, bin_file);
     //reader.PrintTypeData(struct_name, false/* struct */);
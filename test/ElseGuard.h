@@ -0,0 +1,18 @@
+#ifndef _ELSE_GUARD_
+#define _ELSE_GUARD_
+
+// an include guard with an #else is not included only once, the other branch is used when it's included again
+typedef struct FirstInclusion
+{
+    int count;
+}FirstInclusion;
+
+#else
+
+typedef struct NextInclusion
+{
+    int count;
+    int again;
+}NextInclusion;
+
+#endif